@@ -16,6 +16,10 @@
 #include <assert.h>
 #include <float.h>
 #include <time.h>
+#ifdef MM_THREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
@@ -30,6 +34,40 @@
 #define MAXLINE     1024 /* max string size */
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
+#define FOOTPRINT_SAMPLES 10 /* heap sizes printed per trace by -F */
+
+/* The producer/consumer benchmark (-P) */
+#define PC_OPS    200000 /* blocks each thread allocates */
+#define PC_RING   256    /* blocks in flight between two threads */
+#define PC_MAXSIZE 1024  /* largest block size */
+#define PC_MAXTHREADS 64 /* most threads */
+
+/* The batch benchmark (-B) */
+#define BATCH_OBJS  (1 << 20) /* blocks allocated and freed per size */
+#define BATCH_MAXN  1024      /* most blocks in a batch */
+
+/* The placement policy comparison (-p) */
+#define POLICY_RUNS  5         /* timings of each trace under each policy */
+
+/* The compaction benchmark (-C) */
+#define COMPACT_SLOTS  1024    /* blocks live at once */
+#define COMPACT_OPS    (1 << 19) /* blocks replaced */
+#define COMPACT_MAXLO  4096    /* least size of the last blocks */
+#define DRAIN_BLOCKS   64      /* fixed blocks around the handles */
+#define DRAIN_HANDLES  16      /* handles, all but one freed */
+#define DRAIN_SIZE     40000   /* bytes in a fixed block */
+
+/* The mixed-lifetime churn of the lifetime comparison (-L) */
+#define LIFE_PHASES  (1 << 14) /* phases, each with a burst of temporaries */
+#define LIFE_KEPT    2048      /* long-lived blocks live at once */
+#define LIFE_BURST   64        /* most temporaries per phase */
+
+/* The pointer-chasing benchmark (-N) */
+#define NEAR_LISTS   16        /* lists built side by side */
+#define NEAR_NODES   1024      /* nodes per list */
+#define NEAR_FILL    32768     /* blocks allocated first, 3/4 of them freed */
+#define NEAR_WALKS   50        /* traversals of every list */
+#define NEAR_RUNS    9         /* rounds of each kind, interleaved */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p)  ((((uintptr_t)(p)) % ALIGNMENT) == 0)
@@ -86,10 +124,32 @@ typedef struct {
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
 
+#ifdef MM_THREADS
+/*
+ * A ring of blocks passed from one benchmark thread to the next.  The
+ * producer only writes tail and the consumer only writes head.
+ */
+typedef struct {
+    void *slots[PC_RING];
+    unsigned head;            /* next slot to consume */
+    unsigned tail;            /* next slot to fill */
+    pthread_t tid;            /* the consuming thread */
+} pc_ring_t;
+#endif
+
 /********************
  * Global variables
  *******************/
 int verbose = 0;        /* global flag for verbose output */
+static int footprint = 0; /* print the heap footprint over time (-F) */
+static int print_stats = 0; /* print the allocator's statistics (-S) */
+static char *tune_file = NULL; /* header to write the best geometry to (-T) */
+static int compare_policies = 0; /* compare the placement policies (-p) */
+static int compare_lifetime = 0; /* compare lifetime-aware placement (-L) */
+static int pc_threads = 0; /* most threads for the benchmark (-P) */
+static int batch_n = 0;    /* blocks per batch for the benchmark (-B) */
+static long compact_budget = -1; /* bytes per mm_compact call (-C) */
+static int near_bench = 0; /* run the pointer-chasing benchmark (-N) */
 static int errors = 0;  /* number of errs found when running student malloc */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
@@ -128,6 +188,25 @@ static void eval_mm_speed(void *ptr);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printmmstats(int tracenum);
+static void tune(char **tracefiles, int num_tracefiles);
+static void policies(char **tracefiles, int num_tracefiles);
+static void lifetimes(char **tracefiles, int num_tracefiles);
+static double lifetime_round(int mode, size_t *live, size_t *peak,
+    long *ops);
+static void batchbench(int n);
+static double batch_round(int n, size_t size, int batched);
+static void compactbench(size_t budget);
+static double compact_round(size_t budget, int movable, size_t *live,
+    size_t *peak);
+static size_t compact_drain(void);
+static void nearbench(void);
+static double near_round(int near, double *local, size_t *heap);
+static int secs_cmp(const void *a, const void *b);
+#ifdef MM_THREADS
+static void pcbench(int max_threads);
+static void *pc_worker(void *arg);
+#endif
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -159,7 +238,7 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:hvVgalpLNFST:P:B:C:")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -191,6 +270,39 @@ int main(int argc, char **argv)
         case 'V': /* Be more verbose than -v */
             verbose = 2;
             break;
+        case 'F': /* Print the heap footprint over time */
+            footprint = 1;
+            break;
+        case 'S': /* Print the allocator's statistics after each trace */
+            print_stats = 1;
+            break;
+        case 'p': /* Compare the placement policies on every trace */
+            compare_policies = 1;
+            break;
+        case 'L': /* Compare placement by predicted lifetime on every trace */
+            compare_lifetime = 1;
+            break;
+        case 'T': /* Tune the allocator's geometry and write it to a header */
+            tune_file = optarg;
+            break;
+        case 'P': /* Run the producer/consumer benchmark on 1 to n threads */
+            pc_threads = atoi(optarg);
+            if (pc_threads < 1 || pc_threads > PC_MAXTHREADS)
+		app_error("-P needs between 1 and 64 threads");
+            break;
+        case 'B': /* Compare batched with one-at-a-time allocation */
+            batch_n = atoi(optarg);
+            if (batch_n < 1 || batch_n > BATCH_MAXN)
+		app_error("-B needs between 1 and 1024 blocks");
+            break;
+        case 'C': /* Compare movable with fixed blocks under churn */
+            compact_budget = atol(optarg);
+            if (compact_budget < 0)
+		app_error("-C needs a budget of at least 0 bytes");
+            break;
+        case 'N': /* Compare lists built with mm_malloc_near and without */
+            near_bench = 1;
+            break;
         case 'h': /* Print this message */
 	    usage();
             exit(0);
@@ -239,6 +351,52 @@ int main(int argc, char **argv)
     /* Initialize the timing package */
     init_fsecs();
 
+    /* Tuning replaces the usual evaluation. */
+    if (tune_file != NULL) {
+	tune(tracefiles, num_tracefiles);
+	exit(0);
+    }
+
+    /* So does the comparison of placement policies. */
+    if (compare_policies) {
+	policies(tracefiles, num_tracefiles);
+	exit(0);
+    }
+
+    /* And the comparison of placement by predicted lifetime. */
+    if (compare_lifetime) {
+	lifetimes(tracefiles, num_tracefiles);
+	exit(0);
+    }
+
+    /* So does the producer/consumer benchmark. */
+    if (pc_threads > 0) {
+#ifdef MM_THREADS
+	pcbench(pc_threads);
+	exit(0);
+#else
+	app_error("-P needs mm.c built with MM_THREADS");
+#endif
+    }
+
+    /* And so does the batch benchmark. */
+    if (batch_n > 0) {
+	batchbench(batch_n);
+	exit(0);
+    }
+
+    /* And so does the compaction benchmark. */
+    if (compact_budget >= 0) {
+	compactbench((size_t)compact_budget);
+	exit(0);
+    }
+
+    /* And so does the pointer-chasing benchmark. */
+    if (near_bench) {
+	nearbench();
+	exit(0);
+    }
+
     /*
      * Optionally run and evaluate the libc malloc package 
      */
@@ -396,9 +554,10 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap or a region */
+    if (((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
+	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) &&
+	!mem_is_mapped(lo, hi)) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
@@ -436,12 +595,10 @@ static void remove_range(range_t **ranges, char *lo)
 {
     range_t *p;
     range_t **prevpp = ranges;
-    int size;
 
     for (p = *ranges;  p != NULL; p = p->next) {
         if (p->lo == lo) {
 	    *prevpp = p->next;
-            size = p->hi - p->lo + 1;
             free(p);
             break;
         }
@@ -690,10 +847,14 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   The idea is to remember the high water mark "hwm" of the heap for 
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the 
- *   size of the heap in bytes after running the student's malloc 
- *   package on the trace. Note that our implementation of mem_sbrk() 
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
+ *   largest footprint, the heap plus any regions mapped with mem_map(),
+ *   reached while running the student's malloc package on the trace.
+ *   The allocator may shrink the heap with a negative mem_sbrk(), so the
+ *   final brk can be below its high water mark.
+ *
+ *   With -F, the heap size is also printed at evenly spaced points of
+ *   the trace, followed by what mm_trim() releases at the end.  With -S,
+ *   the statistics from mm_stats() are printed at the end of the trace.
  *   
  */
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
@@ -705,6 +866,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
     int total_size = 0;
     char *p;
     char *newp, *oldp;
+    double util;
 
     /* Remove the unused variable warnings */
     tracenum = tracenum;
@@ -714,8 +876,13 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
     mem_reset_brk();
     if (mm_init() < 0)
 	app_error("mm_init failed in eval_mm_util");
+    if (footprint)
+	printf("trace %d footprint (KB):", tracenum);
 
     for (i = 0;  i < trace->num_ops;  i++) {
+	if (footprint &&
+	    i % ((trace->num_ops + FOOTPRINT_SAMPLES - 1) / FOOTPRINT_SAMPLES) == 0)
+	    printf(" %zu", (mem_heapsize() + mem_mapsize()) / 1024);
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_alloc */
@@ -779,7 +946,15 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
         }
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    util = (double)max_total_size / (double)mem_peaksize();
+    if (print_stats)
+	printmmstats(tracenum);
+    if (footprint) {
+	printf(" %zu; peak %zu", (mem_heapsize() + mem_mapsize()) / 1024,
+	    mem_peaksize() / 1024);
+	printf("; mm_trim released %zu bytes\n", mm_trim(0));
+    }
+    return (util);
 }
 
 
@@ -1006,19 +1181,770 @@ void malloc_error(int tracenum, int opnum, char *msg)
     printf("ERROR [trace %d, line %d]: %s\n", tracenum, LINENUM(opnum), msg);
 }
 
+/*
+ * printmmstats - Print the statistics of the mm malloc package
+ */
+static void printmmstats(int tracenum)
+{
+    struct mm_stats st;
+    int i;
+
+    mm_stats(&st);
+    printf("trace %d stats: heap %zu KB, mapped %zu KB, live %zu KB, "
+	   "free %zu KB, fast bins %zu KB, top %zu KB\n", tracenum,
+	   st.heap_size / 1024, st.mapped_size / 1024, st.live_bytes / 1024,
+	   st.free_bytes / 1024, st.fast_bytes / 1024, st.top_bytes / 1024);
+    printf("  splits %lu, coalesces %lu, extends %lu, "
+	   "realloc in place %lu, moved %lu\n", st.splits, st.coalesces,
+	   st.extends, st.realloc_inplace, st.realloc_copy);
+    printf("  search lengths:");
+    for (i = 0; i < MM_STATS_SEARCH; i++)
+	printf(" %d%s:%lu", i == 0 ? 0 : 1 << (i - 1),
+	       i == MM_STATS_SEARCH - 1 ? "+" : "", st.search_hist[i]);
+    printf("\n  free blocks by class (size: count):");
+    for (i = 0; i < st.nclasses; i++) {
+	if (st.class_count[i] > 0)
+	    printf(" %zu:%zu", st.class_size[i], st.class_count[i]);
+    }
+    printf("\n");
+}
+
+/*
+ * tune - Run the traces under every geometry of a fixed grid, and write
+ *     the one with the best performance index to tune_file as a header
+ *     that mm.c includes when built with MM_TUNED.  Ties go to the
+ *     higher utilization.
+ */
+static void tune(char **tracefiles, int num_tracefiles)
+{
+    static const size_t low_bounds[] = {64, 128, 256, 512};
+    static const size_t seglst_nums[] = {10, 14, 18, 22};
+    static const size_t chunk_sizes[] = {1 << 10, 1 << 12, 1 << 14, 1 << 16};
+    size_t nlow = sizeof(low_bounds) / sizeof(low_bounds[0]);
+    size_t nnum = sizeof(seglst_nums) / sizeof(seglst_nums[0]);
+    size_t nchunk = sizeof(chunk_sizes) / sizeof(chunk_sizes[0]);
+    size_t l, n, c, best_l = 0, best_n = 0, best_c = 0;
+    trace_t **traces;
+    range_t *ranges = NULL;
+    speed_t speed_params;
+    double secs, ops, util, thru, perf, best_perf = -1, best_util = 0;
+    int i, valid;
+    FILE *fp;
+
+    if ((traces = calloc(num_tracefiles, sizeof(trace_t *))) == NULL)
+	unix_error("traces calloc in tune failed");
+    for (i = 0; i < num_tracefiles; i++)
+	traces[i] = read_trace(tracedir, tracefiles[i]);
+    mem_init();
+
+    printf("%9s%11s%10s%7s%10s%7s\n", "low_bound", "seglst_num",
+	   "chunksize", "util", "Kops", "perf");
+    for (l = 0; l < nlow; l++) {
+	for (n = 0; n < nnum; n++) {
+	    for (c = 0; c < nchunk; c++) {
+		if (mm_setopt(MM_OPT_LOW_BOUND, low_bounds[l]) < 0 ||
+		    mm_setopt(MM_OPT_SEGLST_NUM, seglst_nums[n]) < 0 ||
+		    mm_setopt(MM_OPT_CHUNKSIZE, chunk_sizes[c]) < 0)
+		    continue;
+		printf("%9zu%11zu%10zu", low_bounds[l], seglst_nums[n],
+		       chunk_sizes[c]);
+		fflush(stdout);
+		secs = ops = util = 0;
+		valid = 1;
+		for (i = 0; i < num_tracefiles && valid; i++) {
+		    if (!(valid = eval_mm_valid(traces[i], i, &ranges)))
+			break;
+		    util += eval_mm_util(traces[i], i, &ranges);
+		    speed_params.trace = traces[i];
+		    speed_params.ranges = ranges;
+		    secs += fsecs(eval_mm_speed, &speed_params);
+		    ops += traces[i]->num_ops;
+		}
+		if (!valid) {
+		    printf("   invalid\n");
+		    continue;
+		}
+		/* The performance index, as computed by main() */
+		util /= num_tracefiles;
+		thru = ops / secs;
+		perf = (UTIL_WEIGHT * util + (1.0 - UTIL_WEIGHT) *
+			(thru > AVG_LIBC_THRUPUT ? 1.0 : thru / AVG_LIBC_THRUPUT))
+		    * 100.0;
+		printf("%6.1f%%%10.0f%7.1f\n", util * 100.0, thru / 1e3, perf);
+		if (perf > best_perf || (perf == best_perf && util > best_util)) {
+		    best_perf = perf;
+		    best_util = util;
+		    best_l = l;
+		    best_n = n;
+		    best_c = c;
+		}
+	    }
+	}
+    }
+    for (i = 0; i < num_tracefiles; i++)
+	free_trace(traces[i]);
+    free(traces);
+    if (best_perf < 0)
+	app_error("no geometry ran every trace correctly");
+
+    if ((fp = fopen(tune_file, "w")) == NULL)
+	unix_error("fopen of the tuning header failed");
+    fprintf(fp, "/*\n"
+	    " * Generated by \"mdriver -T\" from %d traces: perf index %.1f,\n"
+	    " * util %.1f%%.  Build with \"make MM_TUNED=1\" to use these "
+	    "defaults.\n"
+	    " */\n"
+	    "#define SEGLST_NUM  (%zu)\n"
+	    "#define LOW_BOUND   (%zu)\n"
+	    "#define CHUNKSIZE   (%zu)\n",
+	    num_tracefiles, best_perf, best_util * 100.0, seglst_nums[best_n],
+	    low_bounds[best_l], chunk_sizes[best_c]);
+    fclose(fp);
+    printf("Best: low_bound %zu, seglst_num %zu, chunksize %zu; wrote %s\n",
+	   low_bounds[best_l], seglst_nums[best_n], chunk_sizes[best_c],
+	   tune_file);
+}
+
+/*
+ * policies - Run the traces under every placement policy, and print the
+ *     utilization and throughput each policy gets on each trace and over
+ *     all of them, side by side.  Each trace is timed POLICY_RUNS times
+ *     under every policy, the policies taking turns and a different one
+ *     going first each round, and the median time counts.  No performance
+ *     index is printed, as its throughput part is capped at the libc
+ *     throughput that every policy reaches.
+ */
+static void policies(char **tracefiles, int num_tracefiles)
+{
+    static const char *names[MM_POLICIES] = {
+	[MM_POLICY_LIFO] = "lifo", [MM_POLICY_NEXT] = "next",
+	[MM_POLICY_BEST] = "best", [MM_POLICY_ADDRESS] = "address"
+    };
+    trace_t *trace;
+    range_t *ranges = NULL;
+    speed_t speed_params;
+    double util[MM_POLICIES], secs[MM_POLICIES];
+    double runs[MM_POLICIES][POLICY_RUNS];
+    double total_util[MM_POLICIES] = {0}, total_secs[MM_POLICIES] = {0};
+    double ops = 0;
+    int i, p, r;
+
+    mem_init();
+    printf("%5s", "");
+    for (p = 0; p < MM_POLICIES; p++)
+	printf("%16s", names[p]);
+    printf("\n%5s", "trace");
+    for (p = 0; p < MM_POLICIES; p++)
+	printf("%8s%8s", "util", "Kops");
+    printf("\n");
+    for (i = 0; i < num_tracefiles; i++) {
+	trace = read_trace(tracedir, tracefiles[i]);
+	for (p = 0; p < MM_POLICIES; p++) {
+	    if (mm_setopt(MM_OPT_POLICY, p) < 0)
+		app_error("mm_setopt failed in policies");
+	    if (!eval_mm_valid(trace, i, &ranges)) {
+		sprintf(msg, "%s placement failed on trace %d", names[p], i);
+		app_error(msg);
+	    }
+	    util[p] = eval_mm_util(trace, i, &ranges);
+	}
+	speed_params.trace = trace;
+	speed_params.ranges = ranges;
+	for (r = 0; r < POLICY_RUNS; r++)
+	    for (p = r % MM_POLICIES; p < r % MM_POLICIES + MM_POLICIES; p++) {
+		mm_setopt(MM_OPT_POLICY, p % MM_POLICIES);
+		runs[p % MM_POLICIES][r] = fsecs(eval_mm_speed, &speed_params);
+	    }
+	printf("%5d", i);
+	for (p = 0; p < MM_POLICIES; p++) {
+	    qsort(runs[p], POLICY_RUNS, sizeof(double), secs_cmp);
+	    secs[p] = runs[p][POLICY_RUNS / 2];
+	    total_util[p] += util[p];
+	    total_secs[p] += secs[p];
+	    printf("%7.1f%%%8.0f", util[p] * 100.0,
+		   trace->num_ops / secs[p] / 1e3);
+	}
+	printf("\n");
+	ops += trace->num_ops;
+	free_trace(trace);
+    }
+    mm_setopt(MM_OPT_POLICY, MM_POLICY_LIFO);
+
+    printf("%5s", "Total");
+    for (p = 0; p < MM_POLICIES; p++)
+	printf("%7.1f%%%8.0f", total_util[p] / num_tracefiles * 100.0,
+	       ops / total_secs[p] / 1e3);
+    printf("\n");
+    mem_deinit();
+}
+
+/*
+ * lifetimes - Run the traces with placement by predicted lifetime off and
+ *     on, and print the utilization and throughput of each trace and the
+ *     performance index over all of them, side by side.  Then compare the
+ *     footprint of a churn of short- and long-lived blocks placed by size,
+ *     by predicted lifetime and by hints.
+ */
+static void lifetimes(char **tracefiles, int num_tracefiles)
+{
+    static const char *names[3] = {"size", "predict", "hint"};
+    trace_t *trace;
+    range_t *ranges = NULL;
+    speed_t speed_params;
+    double util[2], secs[2], total_util[2] = {0, 0}, total_secs[2] = {0, 0};
+    double ops = 0, thru;
+    size_t live, peak;
+    long nops;
+    int i, on;
+
+    mem_init();
+    printf("%5s%18s%18s%8s\n", "", "by size", "by lifetime", "");
+    printf("%5s%10s%8s%10s%8s%8s\n", "trace", "util", "Kops", "util", "Kops",
+	   "change");
+    for (i = 0; i < num_tracefiles; i++) {
+	trace = read_trace(tracedir, tracefiles[i]);
+	for (on = 0; on < 2; on++) {
+	    mm_setopt(MM_OPT_LIFETIME, on);
+	    if (!eval_mm_valid(trace, i, &ranges)) {
+		sprintf(msg, "lifetime placement %s failed on trace %d",
+			on ? "on" : "off", i);
+		app_error(msg);
+	    }
+	    util[on] = eval_mm_util(trace, i, &ranges);
+	    speed_params.trace = trace;
+	    speed_params.ranges = ranges;
+	    secs[on] = fsecs(eval_mm_speed, &speed_params);
+	    total_util[on] += util[on];
+	    total_secs[on] += secs[on];
+	}
+	printf("%5d%9.1f%%%8.0f%9.1f%%%8.0f%+7.1f%%\n", i, util[0] * 100.0,
+	       trace->num_ops / secs[0] / 1e3, util[1] * 100.0,
+	       trace->num_ops / secs[1] / 1e3, (util[1] - util[0]) * 100.0);
+	ops += trace->num_ops;
+	free_trace(trace);
+    }
+    mm_setopt(MM_OPT_LIFETIME, 1);
+
+    printf("%5s", "Total");
+    for (on = 0; on < 2; on++)
+	printf("%9.1f%%%8.0f", total_util[on] / num_tracefiles * 100.0,
+	       ops / total_secs[on] / 1e3);
+    printf("%+7.1f%%\n%5s", (total_util[1] - total_util[0]) /
+	   num_tracefiles * 100.0, "perf");
+    for (on = 0; on < 2; on++) {
+	/* The performance index, as computed by main() */
+	thru = ops / total_secs[on];
+	printf("%18.1f", (UTIL_WEIGHT * total_util[on] / num_tracefiles +
+			  (1.0 - UTIL_WEIGHT) * (thru > AVG_LIBC_THRUPUT ?
+			  1.0 : thru / AVG_LIBC_THRUPUT)) * 100.0);
+    }
+    printf("\n");
+
+    /* The traces mix few lifetimes within a size, so churn some that do. */
+    printf("\n%8s%12s%12s%8s%10s\n", "churn", "peak live", "peak heap",
+	   "util", "ns/op");
+    for (on = 0; on < 3; on++) {
+	secs[0] = lifetime_round(on, &live, &peak, &nops);
+	printf("%8s%12zu%12zu%7.0f%%%10.1f\n", names[on], live, peak,
+	       100.0 * live / peak, secs[0] * 1e9 / nops);
+    }
+    mem_deinit();
+}
+
+/*
+ * lifetime_round - Run LIFE_PHASES phases on a fresh heap, each of which
+ *     allocates a burst of temporaries of 200-500 bytes, replaces the
+ *     oldest of LIFE_KEPT long-lived blocks of 120-200 bytes halfway
+ *     through, and frees the burst.  Mode 0 places blocks by size alone,
+ *     mode 1 by predicted lifetime and mode 2 by hints.  Sets *live to the
+ *     most bytes requested by live blocks, *peak to the largest the heap
+ *     grew and *ops to the calls made, and returns the seconds it took.
+ */
+static double lifetime_round(int mode, size_t *live, size_t *peak,
+    long *ops)
+{
+    static void *kept[LIFE_KEPT];
+    static size_t kept_sizes[LIFE_KEPT];
+    void *burst[LIFE_BURST];
+    size_t burst_sizes[LIFE_BURST], bytes = 0;
+    struct timespec start, end;
+    int phase, n, i, k = 0;
+
+    mem_reset_brk();
+    mm_setopt(MM_OPT_LIFETIME, mode == 1);
+    if (mm_init() < 0)
+	app_error("mm_init failed.");
+    memset(kept, 0, sizeof(kept));
+    *live = *peak = 0;
+    *ops = 0;
+    srand(1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (phase = 0; phase < LIFE_PHASES; phase++) {
+	n = 1 + rand() % LIFE_BURST;
+	for (i = 0; i < n; i++) {
+	    if (i == n / 2) {
+		if (kept[k] != NULL) {
+		    mm_free(kept[k]);
+		    bytes -= kept_sizes[k];
+		    (*ops)++;
+		}
+		kept_sizes[k] = 120 + rand() % 81;
+		kept[k] = mm_malloc_hint(kept_sizes[k],
+					 mode == 2 ? MM_HINT_LONG : MM_HINT_NONE);
+		if (kept[k] == NULL)
+		    app_error("allocation failed in lifetime_round");
+		bytes += kept_sizes[k];
+		k = (k + 1) % LIFE_KEPT;
+		(*ops)++;
+	    }
+	    burst_sizes[i] = 200 + rand() % 301;
+	    burst[i] = mm_malloc_hint(burst_sizes[i],
+				      mode == 2 ? MM_HINT_SHORT : MM_HINT_NONE);
+	    if (burst[i] == NULL)
+		app_error("allocation failed in lifetime_round");
+	    bytes += burst_sizes[i];
+	    (*ops)++;
+	    if (bytes > *live)
+		*live = bytes;
+	    if (mem_heapsize() > *peak)
+		*peak = mem_heapsize();
+	}
+	for (i = 0; i < n; i++) {
+	    mm_free(burst[i]);
+	    bytes -= burst_sizes[i];
+	}
+	*ops += n;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    mm_setopt(MM_OPT_LIFETIME, 1);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * batchbench - Measure the cost per block of allocating n blocks of one
+ *     size and then freeing them all, first with n calls each to
+ *     mm_malloc and mm_free, then with one call each to mm_malloc_batch
+ *     and mm_free_batch.
+ */
+static void batchbench(int n)
+{
+    static const size_t sizes[] = {16, 64, 256, 1024, 4096};
+    double one, batch;
+    size_t i;
+
+    mem_init();
+    printf("%7s%12s%12s%9s\n", "size", "ns/single", "ns/batch", "speedup");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+	one = batch_round(n, sizes[i], 0);
+	batch = batch_round(n, sizes[i], 1);
+	printf("%7zu%12.1f%12.1f%8.2fx\n", sizes[i], one * 1e9 / BATCH_OBJS,
+	       batch * 1e9 / BATCH_OBJS, one / batch);
+    }
+    mem_deinit();
+}
+
+/*
+ * batch_round - Allocate and free BATCH_OBJS blocks of the given size on
+ *     a fresh heap, n at a time, batched or not, and return the seconds
+ *     it took.
+ */
+static double batch_round(int n, size_t size, int batched)
+{
+    void *blocks[BATCH_MAXN];
+    struct timespec start, end;
+    int round, i;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed.");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (round = 0; round < BATCH_OBJS / n; round++) {
+	if (batched) {
+	    if (mm_malloc_batch(n, size, blocks) != (size_t)n)
+		app_error("mm_malloc_batch failed in batchbench");
+	} else {
+	    for (i = 0; i < n; i++)
+		if ((blocks[i] = mm_malloc(size)) == NULL)
+		    app_error("mm_malloc failed in batchbench");
+	}
+	for (i = 0; i < n; i++)
+	    *(char *)blocks[i] = (char)i;
+	if (batched)
+	    mm_free_batch(n, blocks);
+	else {
+	    for (i = 0; i < n; i++)
+		mm_free(blocks[i]);
+	}
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * compactbench - Measure the footprint a workload whose block sizes drift
+ *     upward leaves behind, so that the holes of old blocks are too small
+ *     for new ones: first with fixed blocks from mm_malloc, then with
+ *     movable blocks from mm_halloc and a call to mm_compact with the
+ *     given budget after every replacement.  Then checks that a heap
+ *     drained but for one handle trims down to a page at most.
+ */
+static void compactbench(size_t budget)
+{
+    size_t live, peak, heap;
+    double secs;
+    int movable;
+
+    mem_init();
+    printf("%8s%12s%12s%12s%8s%10s\n", "blocks", "live", "peak", "heap",
+	   "util", "ns/op");
+    for (movable = 0; movable <= 1; movable++) {
+	secs = compact_round(budget, movable, &live, &peak);
+	heap = mem_heapsize();
+	printf("%8s%12zu%12zu%12zu%7.0f%%%10.1f\n",
+	       movable ? "movable" : "fixed", live, peak, heap,
+	       100.0 * live / heap, secs * 1e9 / COMPACT_OPS);
+    }
+    heap = compact_drain();
+    printf("%8s%36zu\n", "drained", heap);
+    if (heap > mem_pagesize())
+	app_error("a drained heap with a handle left did not trim");
+    mem_deinit();
+}
+
+/*
+ * compact_round - Replace COMPACT_OPS random blocks of COMPACT_SLOTS on a
+ *     fresh heap, then release the free space at the heap's end.  Sets
+ *     *live to the bytes requested by the blocks left and *peak to the
+ *     largest the heap grew, and returns the seconds it took.
+ */
+static double compact_round(size_t budget, int movable, size_t *live,
+    size_t *peak)
+{
+    static void *blocks[COMPACT_SLOTS];
+    static size_t sizes[COMPACT_SLOTS];
+    struct timespec start, end;
+    size_t lo;
+    int op, i;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed.");
+    memset(blocks, 0, sizeof(blocks));
+    *peak = 0;
+    srand(1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (op = 0; op < COMPACT_OPS; op++) {
+	i = rand() % COMPACT_SLOTS;
+	if (blocks[i] != NULL) {
+	    if (movable)
+		mm_hfree(blocks[i]);
+	    else
+		mm_free(blocks[i]);
+	}
+	/* Sizes drift from 16-32 bytes up to about COMPACT_MAXLO-2x. */
+	lo = 16 + (size_t)op * (COMPACT_MAXLO - 16) / COMPACT_OPS;
+	sizes[i] = lo + rand() % lo;
+	blocks[i] = movable ? (void *)mm_halloc(sizes[i]) :
+	    mm_malloc(sizes[i]);
+	if (blocks[i] == NULL)
+	    app_error("allocation failed in compactbench");
+	if (movable)
+	    mm_compact(budget);
+	if (mem_heapsize() > *peak)
+	    *peak = mem_heapsize();
+    }
+    if (movable)
+	mm_compact((size_t)-1);
+    mm_trim(0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    for (*live = 0, i = 0; i < COMPACT_SLOTS; i++)
+	*live += sizes[i];
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * compact_drain - On a fresh heap, allocate half of DRAIN_BLOCKS fixed
+ *     blocks, then DRAIN_HANDLES small movable ones, then the other half,
+ *     and free all of them but the last handle.  After a full compaction
+ *     and a trim nothing should be left but that handle's block, whose
+ *     contents must survive the move.  Returns the heap size.
+ */
+static size_t compact_drain(void)
+{
+    static void *blocks[DRAIN_BLOCKS];
+    struct mm_handle *handles[DRAIN_HANDLES];
+    size_t heap;
+    char *p;
+    int i;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed.");
+    for (i = 0; i < DRAIN_BLOCKS / 2; i++)
+	blocks[i] = mm_malloc(DRAIN_SIZE);
+    for (i = 0; i < DRAIN_HANDLES; i++)
+	handles[i] = mm_halloc(64);
+    for (i = DRAIN_BLOCKS / 2; i < DRAIN_BLOCKS; i++)
+	blocks[i] = mm_malloc(DRAIN_SIZE);
+    for (i = 0; i < DRAIN_BLOCKS; i++) {
+	if (blocks[i] == NULL)
+	    app_error("allocation failed in compactbench");
+	mm_free(blocks[i]);
+    }
+    for (i = 0; i < DRAIN_HANDLES; i++)
+	if (handles[i] == NULL)
+	    app_error("allocation failed in compactbench");
+    for (i = 0; i < DRAIN_HANDLES - 1; i++)
+	mm_hfree(handles[i]);
+    p = mm_hpin(handles[i]);
+    memset(p, 0xa5, 64);
+    mm_hunpin(handles[i]);
+    mm_compact((size_t)-1);
+    mm_trim(0);
+    heap = mem_heapsize();
+    p = mm_hpin(handles[i]);
+    for (i = 0; i < 64; i++)
+	if ((unsigned char)p[i] != 0xa5)
+	    app_error("a handle's block changed when it moved");
+    mm_hunpin(handles[DRAIN_HANDLES - 1]);
+    mm_hfree(handles[DRAIN_HANDLES - 1]);
+    return heap;
+}
+
+/*
+ * nearbench - Measure how fast linked lists are traversed when each node
+ *     is allocated with mm_malloc, and when it is allocated with
+ *     mm_malloc_near next to the node before it.  Prints the share of
+ *     hops that stay within a page, which go to memory the previous node
+ *     has brought into the caches or the TLB already, and the median and
+ *     least time per hop over NEAR_RUNS rounds of each kind.  The rounds
+ *     alternate between the kinds, so that a slow spell of the machine
+ *     does not fall on one kind alone.
+ */
+static void nearbench(void)
+{
+    double secs[2][NEAR_RUNS], local[2];
+    double hops = (double)NEAR_WALKS * NEAR_LISTS * NEAR_NODES;
+    size_t heap[2];
+    int near, r;
+
+    mem_init();
+    for (r = 0; r < NEAR_RUNS; r++)
+	for (near = 0; near <= 1; near++)
+	    secs[near][r] = near_round(near, &local[near], &heap[near]);
+    printf("%8s%12s%12s%10s%12s\n", "nodes", "same page", "ns/hop",
+	   "least", "heap");
+    for (near = 0; near <= 1; near++) {
+	qsort(secs[near], NEAR_RUNS, sizeof(double), secs_cmp);
+	printf("%8s%11.1f%%%12.2f%10.2f%12zu\n", near ? "near" : "malloc",
+	       100.0 * local[near], secs[near][NEAR_RUNS / 2] * 1e9 / hops,
+	       secs[near][0] * 1e9 / hops, heap[near]);
+    }
+    mem_deinit();
+}
+
+/*
+ * secs_cmp - Compare two times for qsort.
+ */
+static int secs_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * near_round - On a fresh heap, allocate NEAR_FILL blocks and free three
+ *     in four of them at random, then build NEAR_LISTS lists of NEAR_NODES
+ *     nodes of 136-256 bytes side by side, a node for each list in turn,
+ *     near the list's last node or not.  Sets *local to the share of hops
+ *     within a page and *heap to the heap size, and returns the seconds
+ *     NEAR_WALKS traversals of every list took after an untimed one.
+ */
+static double near_round(int near, double *local, size_t *heap)
+{
+    struct near_node {
+	struct near_node *next;
+	long val;
+    } *heads[NEAR_LISTS], *tails[NEAR_LISTS], *nd;
+    static void *fill[NEAR_FILL];
+    void *p;
+    struct timespec start, end;
+    long sum = 0, warm = 0, hops = 0;
+    long walk = (long)NEAR_LISTS * NEAR_NODES * (NEAR_NODES - 1) / 2;
+    int i, n, l, w;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed.");
+    srand(1);
+    for (i = 0; i < NEAR_FILL; i++)
+	if ((fill[i] = mm_malloc(136 + rand() % 377)) == NULL)
+	    app_error("mm_malloc failed in nearbench");
+    /* Free three in four of them, in random order. */
+    for (i = NEAR_FILL - 1; i > 0; i--) {
+	n = rand() % (i + 1);
+	p = fill[i];
+	fill[i] = fill[n];
+	fill[n] = p;
+    }
+    for (i = 0; i < NEAR_FILL / 4 * 3; i++)
+	mm_free(fill[i]);
+    for (n = 0; n < NEAR_NODES; n++) {
+	for (l = 0; l < NEAR_LISTS; l++) {
+	    i = 136 + rand() % 121;
+	    nd = n > 0 && near ? mm_malloc_near(tails[l], i) : mm_malloc(i);
+	    if (nd == NULL)
+		app_error("allocation failed in nearbench");
+	    nd->next = NULL;
+	    nd->val = n;
+	    if (n > 0) {
+		tails[l]->next = nd;
+		if ((uintptr_t)tails[l] / 4096 == (uintptr_t)nd / 4096)
+		    hops++;
+	    } else
+		heads[l] = nd;
+	    tails[l] = nd;
+	}
+    }
+    *local = (double)hops / (NEAR_LISTS * (NEAR_NODES - 1));
+    *heap = mem_heapsize();
+    /* An untimed walk brings the lists into the caches first. */
+    for (l = 0; l < NEAR_LISTS; l++)
+	for (nd = heads[l]; nd != NULL; nd = nd->next)
+	    warm += nd->val;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (w = 0; w < NEAR_WALKS; w++)
+	for (l = 0; l < NEAR_LISTS; l++)
+	    for (nd = heads[l]; nd != NULL; nd = nd->next)
+		sum += nd->val;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    /* Each list holds the values 0 to NEAR_NODES - 1. */
+    if (warm != walk || sum != NEAR_WALKS * walk)
+	app_error("lists corrupted in nearbench");
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+#ifdef MM_THREADS
+static pc_ring_t pc_rings[PC_MAXTHREADS]; /* ring i feeds thread i */
+static int pc_nthreads;                   /* threads in the current run */
+
+/*
+ * pcbench - Measure how the allocator scales from 1 to max_threads
+ *     threads when blocks are freed by another thread than the one that
+ *     allocated them.  Thread i allocates PC_OPS blocks, passes each to
+ *     thread i + 1 (mod n) through a ring, and frees the blocks it gets
+ *     from thread i - 1.  With one thread, it frees its own blocks.
+ */
+static void pcbench(int max_threads)
+{
+    struct timespec start, end;
+    double secs, base = 0;
+    int n, i;
+
+    mem_init();
+    printf("%7s%10s%10s%9s\n", "threads", "secs", "Kops", "speedup");
+    for (n = 1; n <= max_threads; n++) {
+	mem_reset_brk();
+	if (mm_init() < 0)
+	    app_error("mm_init failed.");
+	pc_nthreads = n;
+	memset(pc_rings, 0, sizeof(pc_rings));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n; i++) {
+	    if (pthread_create(&pc_rings[i].tid, NULL, pc_worker,
+			       (void *)(intptr_t)i) != 0)
+		unix_error("pthread_create in pcbench failed");
+	}
+	for (i = 0; i < n; i++)
+	    pthread_join(pc_rings[i].tid, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	/* Every block is allocated once and freed once. */
+	if (n == 1)
+	    base = 2.0 * PC_OPS / secs;
+	printf("%7d%10.3f%10.0f%8.2fx\n", n, secs, 2.0 * PC_OPS * n / secs / 1e3,
+	       2.0 * PC_OPS * n / secs / base);
+    }
+    mem_deinit();
+}
+
+/*
+ * pc_worker - The body of benchmark thread arg: produce into the next
+ *     thread's ring and consume from its own until both are done.
+ */
+static void *pc_worker(void *arg)
+{
+    int self = (int)(intptr_t)arg;
+    pc_ring_t *in = &pc_rings[self];
+    pc_ring_t *out = &pc_rings[(self + 1) % pc_nthreads];
+    unsigned seed = self + 1;
+    int sent = 0, received = 0, progress;
+    unsigned head, tail;
+    size_t size;
+    char *p;
+
+    while (sent < PC_OPS || received < PC_OPS) {
+	progress = sent + received;
+	/* Produce as long as the next thread's ring has room. */
+	tail = out->tail;
+	while (sent < PC_OPS &&
+	       tail - __atomic_load_n(&out->head, __ATOMIC_ACQUIRE) < PC_RING) {
+	    size = 1 + rand_r(&seed) % PC_MAXSIZE;
+	    if ((p = mm_malloc(size)) == NULL)
+		app_error("mm_malloc failed in pc_worker");
+	    p[0] = p[size - 1] = (char)self;
+	    out->slots[tail % PC_RING] = p;
+	    __atomic_store_n(&out->tail, ++tail, __ATOMIC_RELEASE);
+	    sent++;
+	}
+	/* Consume whatever the previous thread has produced. */
+	head = in->head;
+	tail = __atomic_load_n(&in->tail, __ATOMIC_ACQUIRE);
+	if (head == tail && progress == sent + received)
+	    sched_yield(); /* Let the other threads catch up. */
+	while (head != tail) {
+	    p = in->slots[head % PC_RING];
+	    if (p[0] != (char)((self + pc_nthreads - 1) % pc_nthreads))
+		app_error("block corrupted in pc_worker");
+	    mm_free(p);
+	    __atomic_store_n(&in->head, ++head, __ATOMIC_RELEASE);
+	    received++;
+	}
+    }
+    return NULL;
+}
+#endif
+
 /* 
  * usage - Explain the command line arguments
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValpLNFS] [-f <file>] [-t <dir>] "
+	    "[-T <header>] [-P <n>] [-B <n>] [-C <n>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
+    fprintf(stderr, "\t-B <n>     Benchmark batches of <n> blocks against "
+	    "single calls.\n");
+    fprintf(stderr, "\t-C <n>     Benchmark compaction with <n> bytes "
+	    "per step against fixed blocks.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "\t-F         Print the heap footprint over time.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-p         Compare the placement policies on "
+	    "every trace.\n");
+    fprintf(stderr, "\t-L         Compare placement by predicted lifetime "
+	    "on every trace.\n");
+    fprintf(stderr, "\t-N         Benchmark lists built with mm_malloc_near "
+	    "against mm_malloc.\n");
+    fprintf(stderr, "\t-P <n>     Benchmark 1 to <n> threads freeing "
+	    "each other's blocks.\n");
+    fprintf(stderr, "\t-S         Print allocator statistics after each trace.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-T <file>  Tune the allocator and write <file>.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
 }
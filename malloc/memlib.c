@@ -2,6 +2,10 @@
  * memlib.c - a module that simulates the memory system.  Needed because it 
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
+ *
+ * The storage is mapped directly and memlib never calls malloc, so the
+ * same module also backs the allocator when it replaces malloc itself in
+ * the shared library built with MM_SHIM.
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,28 +14,78 @@
 #include <sys/mman.h>
 #include <string.h>
 #include <errno.h>
+#include <stdint.h>
+#ifdef MM_THREADS
+#include <pthread.h>
+#endif
 
 #include "memlib.h"
 #include "config.h"
 
+/*
+ * Besides the heap, memory can be mapped in regions, which model mmap().
+ * Regions are carved out of the same storage as the heap, from its top
+ * down, so the heap and the regions grow toward each other.  Each region
+ * is a whole number of pages and starts on a page boundary.
+ */
+typedef struct mem_region {
+    char *lo;                /* first byte of the region */
+    size_t size;             /* size of the region in bytes */
+    struct mem_region *next; /* next lower region */
+} mem_region_t;
+
 /* private variables */
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static mem_region_t *mem_regions; /* mapped regions, highest first */
+static size_t mem_mapped;    /* total size of the mapped regions */
+static size_t mem_peak;      /* largest footprint since the reset */
+static mem_region_t *mem_spare; /* unused region records */
+static char *mem_brk_max;    /* highest the break has been */
+static char *mem_region_min; /* lowest byte any region has had */
+
+/*
+ * In thread-safe mode, one lock serializes every call that reads or
+ * changes the break or the regions, so threads may grow the heap and map
+ * regions at the same time.
+ */
+#ifdef MM_THREADS
+static pthread_mutex_t mem_lock = PTHREAD_MUTEX_INITIALIZER;
+#define MEM_LOCK()    pthread_mutex_lock(&mem_lock)
+#define MEM_UNLOCK()  pthread_mutex_unlock(&mem_lock)
+#else
+#define MEM_LOCK()
+#define MEM_UNLOCK()
+#endif
+
+static void mem_update_peak(void);
+static void mem_unmap_all(void);
+static char *mem_lowest_region(void);
+static mem_region_t *mem_region_new(void);
+static void mem_release(char *lo, char *hi);
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
-    /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-	fprintf(stderr, "mem_init_vm: malloc error\n");
+    /* map the storage we will use to model the available VM */
+    mem_start_brk = (char *)mmap(NULL, MAX_HEAP, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+				 -1, 0);
+    if (mem_start_brk == MAP_FAILED) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
 	exit(1);
     }
 
     mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_regions = NULL;                       /* and nothing is mapped */
+    mem_mapped = 0;
+    mem_peak = 0;
+    mem_brk_max = mem_start_brk;              /* all of it is still zero */
+    mem_region_min = mem_max_addr;
 }
 
 /* 
@@ -39,35 +93,297 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    mem_unmap_all();
+    munmap(mem_start_brk, MAX_HEAP);
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap,
+ *    and unmap every region
  */
 void mem_reset_brk()
 {
+    MEM_LOCK();
     mem_brk = mem_start_brk;
+    mem_unmap_all();
+    mem_peak = 0;
+    MEM_UNLOCK();
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr shrinks the heap by -incr bytes, but never below its
+ *    start, and returns the old brk.
  */
 void *mem_sbrk(intptr_t incr) 
 {
-    char *old_brk = mem_brk;
+    char *old_brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    MEM_LOCK();
+    old_brk = mem_brk;
+    if (incr < 0 && -incr > mem_brk - mem_start_brk) {
+	MEM_UNLOCK();
+	errno = EINVAL;
+	fprintf(stderr, "ERROR: mem_sbrk failed. Heap shrunk below its start...\n");
+	return (void *)-1;
+    }
+    if (incr > 0 && incr > mem_lowest_region() - mem_brk) {
+	MEM_UNLOCK();
 	errno = ENOMEM;
+#ifndef MM_SHIM
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
+#endif
 	return (void *)-1;
     }
     mem_brk += incr;
+    if (incr < 0)
+	mem_release(mem_brk, old_brk);
+    if (mem_brk > mem_brk_max)
+	mem_brk_max = mem_brk;
+    mem_update_peak();
+    MEM_UNLOCK();
     return (void *)old_brk;
 }
 
+/*
+ * mem_map - simple model of an anonymous mmap. Maps a region of at
+ *    least size bytes, rounded up to whole pages, and returns its start
+ *    address, which is page aligned. Regions are placed in the first
+ *    gap from the top that is large enough, and never overlap the heap.
+ */
+void *mem_map(size_t size)
+{
+    size_t pagesize = mem_pagesize();
+    char *top = (char *)((uintptr_t)mem_max_addr & ~(pagesize - 1));
+    mem_region_t *r, **prevp = &mem_regions;
+
+    size = (size + pagesize - 1) & ~(pagesize - 1);
+    MEM_LOCK();
+    for (r = mem_regions; r != NULL; r = r->next) {
+	if ((size_t)(top - (r->lo + r->size)) >= size)
+	    break;
+	top = r->lo;
+	prevp = &r->next;
+    }
+    if (size == 0 || size > (size_t)(top - mem_brk)) {
+	MEM_UNLOCK();
+	errno = ENOMEM;
+#ifndef MM_SHIM
+	fprintf(stderr, "ERROR: mem_map failed. Ran out of memory...\n");
+#endif
+	return (void *)-1;
+    }
+    if ((r = mem_region_new()) == NULL) {
+	MEM_UNLOCK();
+	errno = ENOMEM;
+#ifndef MM_SHIM
+	fprintf(stderr, "ERROR: mem_map failed. Out of region records...\n");
+#endif
+	return (void *)-1;
+    }
+    r->lo = top - size;
+    r->size = size;
+    if (r->lo < mem_region_min)
+	mem_region_min = r->lo;
+    r->next = *prevp;
+    *prevp = r;
+    mem_mapped += size;
+    mem_update_peak();
+    MEM_UNLOCK();
+    return (void *)r->lo;
+}
+
+/*
+ * mem_unmap - unmap the region that starts at addr, which must have
+ *    been returned by mem_map with the same size. Returns 0 on success
+ *    and -1 otherwise.
+ */
+int mem_unmap(void *addr, size_t size)
+{
+    size_t pagesize = mem_pagesize();
+    mem_region_t *r, **prevp = &mem_regions;
+
+    size = (size + pagesize - 1) & ~(pagesize - 1);
+    MEM_LOCK();
+    for (r = mem_regions; r != NULL; r = r->next) {
+	if (r->lo == (char *)addr && r->size == size) {
+	    *prevp = r->next;
+	    mem_mapped -= size;
+	    mem_release(r->lo, r->lo + r->size);
+	    r->next = mem_spare;
+	    mem_spare = r;
+	    MEM_UNLOCK();
+	    return 0;
+	}
+	prevp = &r->next;
+    }
+    MEM_UNLOCK();
+    errno = EINVAL;
+    fprintf(stderr, "ERROR: mem_unmap failed. No such region...\n");
+    return -1;
+}
+
+/*
+ * mem_map_lo - return the address of the lowest mapped byte, or the end
+ *    of the storage if nothing is mapped
+ */
+char *mem_map_lo(void)
+{
+    char *lo;
+
+    MEM_LOCK();
+    lo = mem_lowest_region();
+    MEM_UNLOCK();
+    return lo;
+}
+
+/*
+ * mem_is_mapped - return 1 if the bytes lo to hi lie within a single
+ *    mapped region, and 0 otherwise
+ */
+int mem_is_mapped(void *lo, void *hi)
+{
+    mem_region_t *r;
+    int mapped = 0;
+
+    MEM_LOCK();
+    for (r = mem_regions; r != NULL; r = r->next) {
+	if ((char *)lo >= r->lo && (char *)hi < r->lo + r->size) {
+	    mapped = 1;
+	    break;
+	}
+    }
+    MEM_UNLOCK();
+    return mapped;
+}
+
+/*
+ * mem_is_zero - return 1 if the bytes lo to hi are known to be zero,
+ *    because they have never been part of the heap or of a region since
+ *    mem_init, and 0 otherwise; in the shared library, where memory given
+ *    back is released, this holds for any bytes beyond the heap outside
+ *    the regions
+ */
+int mem_is_zero(void *lo, void *hi)
+{
+    int zero;
+
+    MEM_LOCK();
+#ifdef MM_SHIM
+    zero = (char *)lo >= mem_brk && (char *)hi < mem_lowest_region();
+#else
+    zero = (char *)lo >= mem_brk_max && (char *)hi < mem_region_min;
+#endif
+    MEM_UNLOCK();
+    return zero;
+}
+
+/*
+ * mem_mapsize - returns the total size of the mapped regions in bytes
+ */
+size_t mem_mapsize(void)
+{
+    size_t mapped;
+
+    MEM_LOCK();
+    mapped = mem_mapped;
+    MEM_UNLOCK();
+    return mapped;
+}
+
+/*
+ * mem_update_peak - record the footprint, the heap plus the mapped
+ *    regions, if it is the largest so far
+ */
+static void mem_update_peak(void)
+{
+    size_t footprint = (size_t)(mem_brk - mem_start_brk) + mem_mapped;
+
+    if (footprint > mem_peak)
+	mem_peak = footprint;
+}
+
+/*
+ * mem_lowest_region - return the address of the lowest mapped byte, or
+ *    the end of the storage if nothing is mapped; the caller holds the
+ *    lock
+ */
+static char *mem_lowest_region(void)
+{
+    mem_region_t *r = mem_regions;
+
+    if (r == NULL)
+	return mem_max_addr;
+    while (r->next != NULL)
+	r = r->next;
+    return r->lo;
+}
+
+/*
+ * mem_region_new - return an unused region record, mapping a page of
+ *    new records if there are none, or NULL if none can be mapped; the
+ *    caller holds the lock
+ */
+static mem_region_t *mem_region_new(void)
+{
+    size_t pagesize = mem_pagesize();
+    mem_region_t *r;
+    size_t i;
+
+    if (mem_spare == NULL) {
+	r = (mem_region_t *)mmap(NULL, pagesize, PROT_READ | PROT_WRITE,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (r == MAP_FAILED)
+	    return NULL;
+	for (i = 0; i < pagesize / sizeof(mem_region_t); i++) {
+	    r[i].next = mem_spare;
+	    mem_spare = &r[i];
+	}
+    }
+    r = mem_spare;
+    mem_spare = r->next;
+    return r;
+}
+
+/*
+ * mem_release - in the shared library, give the whole pages between lo
+ *    and hi, which no longer hold the heap or a region, back to the
+ *    system, and clear the rest, so that all of it reads as zero; the
+ *    caller holds the lock, so nothing reuses them meanwhile
+ */
+static void mem_release(char *lo, char *hi)
+{
+#ifdef MM_SHIM
+    uintptr_t mask = mem_pagesize() - 1;
+    char *start = (char *)(((uintptr_t)lo + mask) & ~mask);
+    char *end = (char *)(((uintptr_t)hi + mask) & ~mask);
+
+    memset(lo, 0, (start < hi ? start : hi) - lo);
+    if (end > start)
+	madvise(start, end - start, MADV_DONTNEED);
+#else
+    (void)lo;
+    (void)hi;
+#endif
+}
+
+/*
+ * mem_unmap_all - unmap every region
+ */
+static void mem_unmap_all(void)
+{
+    mem_region_t *r, *next;
+
+    for (r = mem_regions; r != NULL; r = next) {
+	next = r->next;
+	r->next = mem_spare;
+	mem_spare = r;
+    }
+    mem_regions = NULL;
+    mem_mapped = 0;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -81,7 +397,12 @@ void *mem_heap_lo()
  */
 void *mem_heap_hi()
 {
-    return (void *)(mem_brk - 1);
+    void *hi;
+
+    MEM_LOCK();
+    hi = (void *)(mem_brk - 1);
+    MEM_UNLOCK();
+    return hi;
 }
 
 /*
@@ -89,7 +410,27 @@ void *mem_heap_hi()
  */
 size_t mem_heapsize() 
 {
-    return (size_t)(mem_brk - mem_start_brk);
+    size_t size;
+
+    MEM_LOCK();
+    size = (size_t)(mem_brk - mem_start_brk);
+    MEM_UNLOCK();
+    return size;
+}
+
+/*
+ * mem_peaksize() - returns the largest footprint, the size of the heap
+ *    plus that of the mapped regions, since the last mem_init or
+ *    mem_reset_brk, in bytes
+ */
+size_t mem_peaksize() 
+{
+    size_t peak;
+
+    MEM_LOCK();
+    peak = mem_peak;
+    MEM_UNLOCK();
+    return peak;
 }
 
 /*
@@ -5,4 +5,11 @@ void mem_reset_brk(void);
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
+size_t mem_peaksize(void);
+void *mem_map(size_t size);
+int mem_unmap(void *addr, size_t size);
+char *mem_map_lo(void);
+int mem_is_mapped(void *lo, void *hi);
+int mem_is_zero(void *lo, void *hi);
+size_t mem_mapsize(void);
 size_t mem_pagesize(void);
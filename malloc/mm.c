@@ -7,21 +7,45 @@
  * than necessary; the assignment only requires 8-byte alignment.  The
  * minimum block size is four words.
  *
+ * Only free blocks carry a footer.  Every header records, next to the
+ * allocated bit, whether the previous block is allocated, which is all
+ * that coalescing needs to know about an allocated neighbor.  An
+ * allocated block's payload therefore extends to the end of the block.
+ *
  * This allocator uses the size of a pointer, e.g., sizeof(void *), to
  * define the size of a word.  This allocator also uses the standard
  * type uintptr_t to define unsigned integers that are the same size
  * as a pointer, i.e., sizeof(uintptr_t) == sizeof(void *).
+ *
+ * When built with MM_COMPACT, a word is four bytes instead: headers and
+ * footers are 32-bit tags, and the free-list and tree links are 32-bit
+ * offsets from the start of the heap.  This halves the metadata and the
+ * minimum block size, and limits the heap to 4 GB.  Block sizes and
+ * payload addresses stay multiples of ALIGN_SIZE in both modes.  It is 8
+ * unless MM_ALIGN sets a larger power of two, such as the 16 bytes the
+ * x86-64 C library guarantees, which the shared library build uses.
  */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <stdlib.h>
+#ifdef MM_THREADS
+#include <pthread.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
+#include "config.h"
 #include "memlib.h"
 #include "mm.h"
+#ifdef MM_TUNED
+#include "mm_tuned.h"	/* Defaults chosen by "mdriver -T" */
+#endif
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -41,70 +65,714 @@ team_t team = {
 };
 
 /* Basic constants and macros: */
-#define WSIZE      sizeof(void *) /* Word and header/footer size (bytes) */
+#ifdef MM_COMPACT
+typedef uint32_t word_t;          /* A header/footer tag */
+#if MAX_HEAP > 0xffffffffUL
+#error "MM_COMPACT requires MAX_HEAP below 4 GB"
+#endif
+#else
+typedef uintptr_t word_t;
+#endif
+#define WSIZE      sizeof(word_t) /* Word and header/footer size (bytes) */
 #define DSIZE      (2 * WSIZE)    /* Doubleword size (bytes) */
-#define CHUNKSIZE  (1 << 12)      /* Extend heap by this amount (bytes) */
+#ifdef MM_ALIGN
+#define ALIGN_SIZE MM_ALIGN       /* Block size and payload alignment */
+#else
+#define ALIGN_SIZE 8
+#endif
+#if ALIGN_SIZE < 8 || (ALIGN_SIZE & (ALIGN_SIZE - 1)) != 0
+#error "MM_ALIGN must be a power of two no less than 8"
+#endif
+/* The prologue is the smallest block that keeps the payloads aligned. */
+#define PROLOGUE_SIZE  MAX(DSIZE, ALIGN_SIZE)
+#ifndef CHUNKSIZE
+#define CHUNKSIZE  (1 << 12)      /* Default MM_OPT_CHUNKSIZE */
+#endif
+
+/* Round size up to a multiple of ALIGN_SIZE. */
+#define ALIGN_UP(size)  (((size) + ALIGN_SIZE - 1) & ~(size_t)(ALIGN_SIZE - 1))
+
+/*
+ * A free block at the end of the heap that reaches the trim threshold is
+ * returned to memlib, except for TRIM_PAD bytes kept for the next request.
+ */
+#define TRIM_THRESHOLD  (128 * 1024)  /* Default MM_OPT_TRIM_THRESHOLD */
+#define TRIM_PAD        chunk_size
+
+/*
+ * Requests of at least the mmap threshold get a region of their own from
+ * memlib instead of a heap block, so huge buffers never pin or fragment
+ * the heap.  A mapped block has a two-word header: the payload's offset
+ * from the start of its region, followed by a tag that reads as an
+ * allocated block of size zero, which no heap block can be.  The first
+ * word of the region holds the region's size.
+ */
+#define MMAP_THRESHOLD  (128 * 1024)  /* Default MM_OPT_MMAP_THRESHOLD */
+#define MMAP_MIN        (1 << 12)     /* Smaller requests are never mapped */
+#define MAP_OFFSET      ALIGN_UP(3 * WSIZE) /* Payload offset in a region */
+
+/* Smaller callocs clear the whole block without checking where it is from */
+#define CALLOC_MIN      (1024)
 
 #define MAX(x, y)  ((x) > (y) ? (x) : (y))  
+#define MIN(x, y)  ((x) < (y) ? (x) : (y))
+
+/*
+ * Realloc slack policy: a block that realloc grows is marked REALLOCED.
+ * Once a marked block has to grow again, it is likely to keep growing, so
+ * it is given a quarter of its current size in extra room, which makes
+ * repeated growth geometric and the number of copies logarithmic.  A marked
+ * block is also not shrunk unless it would lose more than half its size,
+ * which keeps the slack across small oscillations.
+ */
+#define REALLOC_SLACK(size)  (((size) / 4) & ~(size_t)(ALIGN_SIZE - 1))
+
+/* The bits stored next to the size in a header or footer. */
+#define ALLOC       0x1  /* This block is allocated */
+#define PREV_ALLOC  0x2  /* The previous block is allocated */
+#define REALLOCED   0x4  /* This allocated block has grown by realloc */
 
-/* Pack a size and allocated bit into a word. */
+/* Pack a size and allocated bits into a word. */
 #define PACK(size, alloc)  ((size) | (alloc))
 
-/* Read and write a word at address p. */
-#define GET(p)       (*(uintptr_t *)(p))
-#define PUT(p, val)  (*(uintptr_t *)(p) = (val))
+/*
+ * Read and write a word at address p.  In thread-safe mode, mm_free reads
+ * the header of its own block without the heap lock while another thread
+ * may be updating the previous-allocated bit in it, so header words are
+ * accessed atomically (plain loads and stores on common hardware).
+ */
+#ifdef MM_THREADS
+#define GET(p)       __atomic_load_n((word_t *)(p), __ATOMIC_RELAXED)
+#define PUT(p, val)  __atomic_store_n((word_t *)(p), (val), __ATOMIC_RELAXED)
+#else
+#define GET(p)       (*(word_t *)(p))
+#define PUT(p, val)  (*(word_t *)(p) = (val))
+#endif
 
 /* Read the size and allocated fields from address p. */
 // #define GET_SIZE(p)   (GET(p) & ~(DSIZE - 1))
-#define GET_SIZE(p)   (GET(p) & ~(WSIZE - 1))
-#define GET_ALLOC(p)  (GET(p) & 0x1)
+#define GET_SIZE(p)        (GET(p) & ~(word_t)(ALIGN_SIZE - 1))
+#define GET_ALLOC(p)       (GET(p) & ALLOC)
+#define GET_PREV_ALLOC(p)  (GET(p) & PREV_ALLOC)
+#define GET_REALLOCED(p)   (GET(p) & REALLOCED)
 
-/* Given block ptr bp, compute address of its header and footer. */
+/* Set or clear the previous-allocated bit of the header at address p. */
+#define SET_PREV_ALLOC(p)    PUT(p, GET(p) | PREV_ALLOC)
+#define CLEAR_PREV_ALLOC(p)  PUT(p, GET(p) & ~(word_t)PREV_ALLOC)
+
+/*
+ * Given block ptr bp, compute address of its header and footer.  Only free
+ * blocks have a footer.
+ */
 #define HDRP(bp)  ((char *)(bp) - WSIZE)
 #define FTRP(bp)  ((char *)(bp) + GET_SIZE(HDRP(bp)) - DSIZE)
 
-/* Given block ptr bp, compute address of next and previous blocks. */
+/*
+ * Given block ptr bp, compute address of next and previous blocks.  The
+ * previous block can only be found when it is free.
+ */
 #define NEXT_BLKP(bp)  ((char *)(bp) + GET_SIZE(((char *)(bp) - WSIZE)))
 #define PREV_BLKP(bp)  ((char *)(bp) - GET_SIZE(((char *)(bp) - DSIZE)))
 
-/* The number of segregated list */
+/* Given a non-slab block ptr bp, tell whether it lives in a region. */
+#define IS_MAPPED(bp)  (GET_SIZE(HDRP(bp)) == 0)
+/* Given mapped block ptr bp, compute the address of its region. */
+#define MAP_BASE(bp)   ((char *)(bp) - GET((char *)(bp) - DSIZE))
+
+/*
+ * The segregated lists form a two-level size class index.  Blocks smaller
+ * than LOW_BOUND get one exact-size list per word.  Larger blocks are first
+ * split by power of two into SEGLST_NUM - 1 first-level classes, each of
+ * which is subdivided into SEGLST_SUB equal second-level ranges.  A bitmap
+ * of the non-empty lists makes both the class lookup and the search for a
+ * guaranteed fit constant-time.
+ *
+ * SEGLST_NUM and LOW_BOUND are the defaults of the geometry, which can be
+ * changed with mm_setopt() and takes effect at the next mm_init().  The
+ * active geometry is kept in seglst_num and low_bound, and the number of
+ * lists and the first tree list derived from it in seglst_small,
+ * seglst_lists and tree_lst.
+ */
+/* The number of first-level size classes */
+#ifndef SEGLST_NUM
 #define SEGLST_NUM  (18)
-/* The smallest seglist range: 1 - 64 bytes*/
+#endif
+#define SEGLST_NUM_MAX  (24)
+/* The smallest first-level class starts at this size; a power of two */
+#ifndef LOW_BOUND
 #define LOW_BOUND   (128)
+#endif
+/* log2 of the number of second-level classes per first-level class */
+#define SEGLST_SUB_BITS  (2)
+#define SEGLST_SUB       (1 << SEGLST_SUB_BITS)
+/* The most segregated lists any geometry has */
+#define SEGLST_MAX_LISTS  ((int)(TREE_MIN / ALIGN_SIZE) + \
+    (SEGLST_NUM_MAX - 1) * SEGLST_SUB)
+/* The number of 64-bit words in the bitmap of non-empty lists */
+#define SEGLST_MAP_WORDS ((SEGLST_MAX_LISTS + 63) / 64)
+/* The most blocks examined when looking for a fit within one list */
+#define FIT_SEARCH_LIMIT (8)
+/* The most blocks after a given one that mm_malloc_near() looks at */
+#define NEAR_BLOCKS (16)
+/*
+ * The classes of blocks of at least TREE_MIN bytes span wide size ranges.
+ * Instead of a list, each of them holds a splay tree ordered by block size
+ * and then by address, which gives a true best fit in amortized O(log n).
+ * TREE_MIN is a power of two and an upper bound for LOW_BOUND.
+ */
+#define TREE_MIN  (1024)
+/*
+ * A link from one free block to another.  In compact mode it is the
+ * offset of the block from heap_base, where offset 0 stands for NULL, as
+ * no block starts there.
+ */
+#ifdef MM_COMPACT
+typedef uint32_t link_t;
+#define LINK(p)    ((p) == NULL ? 0 : (link_t)((char *)(p) - heap_base))
+#define UNLINK(l)  ((l) == 0 ? NULL : (void *)(heap_base + (l)))
+#else
+typedef void *link_t;
+#define LINK(p)    ((link_t)(p))
+#define UNLINK(l)  ((void *)(l))
+#endif
+
 /*
  * A doubly linked list structure that matches the structure of body of 
  * free blocks 
  */
 struct free_block_body { 
-	struct free_block_body *next;
-	struct free_block_body *prev;
+	link_t next;
+	link_t prev;
 	char	 	  info[0]; 
-} __attribute__((packed, aligned(8)));
+} __attribute__((packed, aligned(ALIGN_SIZE)));
+
+/* Read and write the list links of free block bp. */
+#define NEXT_FREE(bp)  ((struct free_block_body *) \
+    UNLINK(((struct free_block_body *)(bp))->next))
+#define PREV_FREE(bp)  ((struct free_block_body *) \
+    UNLINK(((struct free_block_body *)(bp))->prev))
+#define SET_NEXT_FREE(bp, p)  (((struct free_block_body *)(bp))->next = LINK(p))
+#define SET_PREV_FREE(bp, p)  (((struct free_block_body *)(bp))->prev = LINK(p))
+
+/* The bytes the list or tree links take at the start of a free block */
+#define LINKS_SIZE  (2 * sizeof(link_t))
+
+/* The body of a free block that is kept in a tree instead of a list */
+struct free_tree_node {
+	link_t left;
+	link_t right;
+};
+
+/* Read and write the children of tree node n. */
+#define LEFT(n)    ((struct free_tree_node *)UNLINK((n)->left))
+#define RIGHT(n)   ((struct free_tree_node *)UNLINK((n)->right))
+#define SET_LEFT(n, p)   ((n)->left = LINK(p))
+#define SET_RIGHT(n, p)  ((n)->right = LINK(p))
+
+/* Compare the key (size, addr) with that of tree node n. */
+#define TREE_LESS(size, addr, n)  ((size) < GET_SIZE(HDRP(n)) || \
+    ((size) == GET_SIZE(HDRP(n)) && (char *)(addr) < (char *)(n)))
+#define TREE_MORE(size, addr, n)  ((size) > GET_SIZE(HDRP(n)) || \
+    ((size) == GET_SIZE(HDRP(n)) && (char *)(addr) > (char *)(n)))
+
+/*
+ * A fit search within a second-level list looks at its first
+ * FIT_SEARCH_LIMIT blocks only.  Each such list below the trees keeps the
+ * sizes and links of exactly those blocks, in list order, in a packed side
+ * index, so the search compares all the sizes at once instead of following
+ * the links and loading a header per block.  These blocks are smaller
+ * than TREE_MIN, so a size fits in 16 bits and, with SSE2, all eight of
+ * them in one register.  The last list is never indexed, as it has no
+ * upper bound.
+ */
+#define SIDE_LISTS  (6 * SEGLST_SUB)    /* Most second-level lists indexed */
+#define IS_SIDE_LIST(lst_indx)  \
+    ((lst_indx) >= seglst_small && (lst_indx) < side_lst)
+#define SIDE_OF(lst_indx)  (&ms->side[(lst_indx) - seglst_small])
+
+struct side_index {
+	uint16_t size[FIT_SEARCH_LIMIT]; /* Block sizes, zero past "count" */
+	link_t blk[FIT_SEARCH_LIMIT];    /* The blocks */
+	int count;                       /* The number of blocks indexed */
+};
+
+_Static_assert(TREE_MIN <= INT16_MAX, "side index sizes are 16 bits");
+_Static_assert(TREE_MIN / (2 * DSIZE) <= 1 << 6,
+    "SIDE_LISTS is too small for the lists below TREE_MIN");
+
+/*
+ * A placement policy decides where a block goes on the list of its class
+ * and which block of a list an allocation takes.  The trees are not
+ * subject to it, as they always give the best fit.  Every policy looks at
+ * no more than FIT_SEARCH_LIMIT blocks of a list, and only LIFO first fit
+ * keeps side indexes, which assume that blocks enter at the head.  The
+ * policy is chosen with mm_setopt() and takes effect at mm_init().
+ */
+struct fit_policy {
+	/* Link free block "bp" of "size" bytes into list "lst_indx". */
+	void (*link)(int lst_indx, void *bp, int size);
+	/* Return a block of list "lst_indx" of at least "asize" bytes. */
+	void *(*fit)(int lst_indx, size_t asize);
+};
+
+/*
+ * Small objects of at most SLAB_MAX bytes live in slabs instead of blocks of
+ * their own.  A slab is an allocated block of exactly SLAB_SIZE bytes whose
+ * payload starts on a SLAB_SIZE boundary, so that consecutive slabs tile
+ * the heap without gaps.  The payload begins with a slab header, followed by
+ * objects of a single size class whose free slots are tracked by a bitmap.
+ * A bitmap of the heap's pages tells which pages hold a slab, so an object
+ * needs no header: its slab is found by rounding its address down.
+ */
+#define SLAB_SIZE      (1 << 12)          /* Bytes per slab, incl. tags */
+#define SLAB_MAX       (128)              /* Largest object kept in slabs */
+#define SLAB_CLASSES   (SLAB_MAX / ALIGN_SIZE) /* One class per ALIGN_SIZE */
+#define SLAB_MAP_WORDS ((int)(SLAB_SIZE / ALIGN_SIZE / 64))
+#define SLAB_PAGES     (MAX_HEAP / SLAB_SIZE + 1)
+
+struct slab {
+	struct slab *next;      /* Next slab of the class with a free object */
+	struct slab *prev;      /* Previous slab of the class */
+	uint32_t obj_size;      /* Size of every object in bytes, or 0 */
+	uint32_t nobjs;         /* Number of objects in the slab */
+	uint32_t nfree;         /* Number of free objects */
+	uint32_t used;          /* Bytes of objects handed out, if nursery */
+	uint64_t free_map[SLAB_MAP_WORDS]; /* Set bits mark free objects */
+	char objs[] __attribute__((aligned(ALIGN_SIZE))); /* The objects */
+} __attribute__((aligned(8)));
+
+/* Given object pointer p, compute the address of its slab. */
+#define SLAB_OF(p)  ((struct slab *)((uintptr_t)(p) & ~(uintptr_t)(SLAB_SIZE - 1)))
+
+/*
+ * Blocks predicted to die young are kept apart from the rest, so that
+ * short-lived temporaries do not leave holes between long-lived blocks.
+ * Such a block of at most NURSERY_MAX bytes is bumped off the current
+ * nursery chunk: a slab whose obj_size is zero, whose objects carry a
+ * header like heap blocks, and whose nobjs and nfree count the objects
+ * handed out and freed.  A chunk that fills up is left behind until its
+ * last object is freed; then it waits for reuse on a list of up to
+ * NURSERY_SPARE empty chunks, since its space would not stay free on the
+ * heap for long.  The current chunk instead starts over when it empties,
+ * and freeing its newest object pops it.
+ *
+ * The prediction is keyed on block size.  One in LIFE_PERIOD allocations
+ * of a nursery size is sampled with its birth time, counted in
+ * allocations, into a small table indexed by address.  When a sampled
+ * block is freed, or its entry is evicted after LIFE_SHORT allocations,
+ * the score of its size is trained: up one step for a short life, but
+ * down to -LIFE_SCORE for a long one, as a long-lived block in the
+ * nursery pins a whole chunk.  A positive score predicts a short life, so
+ * a size must die young LIFE_SCORE + 1 times in a row to get there.
+ * Callers that know better pass a hint to mm_malloc_hint().
+ */
+#define NURSERY_MAX   (512)             /* Largest block kept in nurseries */
+#define NURSERY_SPARE (8)               /* Most empty chunks kept */
+#define NURSERY_FIRST(sp) ((sp)->objs + ALIGN_SIZE) /* First object */
+#define LIFE_CLASSES  ((int)(NURSERY_MAX / ALIGN_SIZE + 1)) /* One per size */
+#define LIFE_SAMPLES  (64)              /* Entries in the sample table */
+#define LIFE_PERIOD   (4)               /* Allocations per sample */
+#define LIFE_SHORT    (256)             /* Lifetimes below this are short */
+#define LIFE_SCORE    (16)              /* Bound on a score's magnitude */
+
+/* Given block pointer bp, compute its entry in the sample table. */
+#define LIFE_SLOT(bp) (((uintptr_t)(bp) / ALIGN_SIZE) % LIFE_SAMPLES)
+
+struct life_sample {
+	void *bp;               /* The sampled block, or NULL */
+	size_t birth;           /* The lifetime clock at its allocation */
+	int cls;                /* Its size in units of ALIGN_SIZE */
+};
+
+/*
+ * Freed heap blocks of at most FAST_MAX bytes are not coalesced right away.
+ * They are pushed on an exact-size LIFO fast bin, singly linked through
+ * the first payload word, and stay marked as allocated in the heap, so
+ * their neighbors never merge with them.  A request of the same size pops
+ * one back in constant time.  When a request finds no fit, all fast bins
+ * are consolidated into the segregated lists before the heap is grown.
+ */
+#define FAST_MAX   (1024)               /* Largest block kept in fast bins */
+#define FAST_BINS  ((int)(FAST_MAX / ALIGN_SIZE + 1)) /* One per block size */
+
+/*
+ * An arena hands out objects from a chain of large chunks by bumping a
+ * pointer, and releases all of them at once.  The chunks are ordinary
+ * blocks obtained from mm_malloc, so an arena lives on the same heap as
+ * everything else.  Resetting an arena rewinds it to its first chunk and
+ * keeps the chain for reuse; destroying it frees every chunk.
+ */
+#define ARENA_CHUNK  (64 * 1024)        /* Least bytes per arena chunk */
+
+struct arena_chunk {
+	struct arena_chunk *next; /* Next chunk of the arena */
+	char *end;                /* End of the chunk's data */
+	char data[] __attribute__((aligned(ALIGN_SIZE))); /* The objects */
+} __attribute__((aligned(8)));
+
+struct mm_arena {
+	struct arena_chunk *first; /* First chunk, or NULL if none yet */
+	struct arena_chunk *cur;   /* Chunk being allocated from */
+	char *next;                /* Next free byte in "cur" */
+	char *end;                 /* End of "cur" */
+};
+
+/*
+ * Every block on a segregated list or tree has its bit set in the listed
+ * bitmap, which has one bit per ALIGN_SIZE bytes of the heap.  The
+ * checkers use it to test list membership in constant time.
+ */
+#define LISTED_WORDS  ((int)(MAX_HEAP / ALIGN_SIZE / 64))
+#define LISTED_BIT(bp)  ((size_t)((char *)(bp) - heap_base) / ALIGN_SIZE)
+#ifdef MM_ARENAS
+/* The heaps of two arenas may share a word of the bitmap. */
+#define LISTED_WORD(bp)  (&listed_map[LISTED_BIT(bp) / 64])
+#define LISTED_MASK(bp)  ((uint64_t)1 << (LISTED_BIT(bp) % 64))
+#define GET_LISTED(bp)  ((__atomic_load_n(LISTED_WORD(bp), \
+    __ATOMIC_RELAXED) & LISTED_MASK(bp)) != 0)
+#define SET_LISTED(bp)  \
+    __atomic_fetch_or(LISTED_WORD(bp), LISTED_MASK(bp), __ATOMIC_RELAXED)
+#define CLEAR_LISTED(bp)  \
+    __atomic_fetch_and(LISTED_WORD(bp), ~LISTED_MASK(bp), __ATOMIC_RELAXED)
+#else
+#define GET_LISTED(bp)  \
+    ((listed_map[LISTED_BIT(bp) / 64] >> (LISTED_BIT(bp) % 64)) & 1)
+#define SET_LISTED(bp)  \
+    (listed_map[LISTED_BIT(bp) / 64] |= (uint64_t)1 << (LISTED_BIT(bp) % 64))
+#define CLEAR_LISTED(bp)  \
+    (listed_map[LISTED_BIT(bp) / 64] &= ~((uint64_t)1 << (LISTED_BIT(bp) % 64)))
+#endif
+
+/*
+ * A block allocated through a handle may be moved by the compactor while
+ * the handle is not pinned.  Such a block keeps the address of its handle
+ * in its last word and has its bit set in the handle bitmap, which is laid
+ * out like the listed bitmap.  Handles only refer to blocks of the main
+ * heap, so the bitmap needs no atomics.  Handles themselves are carved
+ * HANDLE_CHUNK at a time out of a region of their own, which never moves
+ * and, unlike a block, cannot keep the heap from being trimmed.
+ */
+struct mm_handle {
+	void *bp;           /* The block, or the next free handle */
+	unsigned pins;      /* Calls to mm_hpin() not yet undone */
+};
+
+#define HANDLE_CHUNK  256
+#define HANDLE_OF(bp)  ((struct mm_handle *)UNLINK(*(link_t *)FTRP(bp)))
+#define SET_HANDLE_OF(bp, h)  (*(link_t *)FTRP(bp) = LINK(h))
+#define GET_HANDLE(bp)  \
+    ((handle_map[LISTED_BIT(bp) / 64] >> (LISTED_BIT(bp) % 64)) & 1)
+#define SET_HANDLE(bp)  \
+    (handle_map[LISTED_BIT(bp) / 64] |= (uint64_t)1 << (LISTED_BIT(bp) % 64))
+#define CLEAR_HANDLE(bp)  \
+    (handle_map[LISTED_BIT(bp) / 64] &= ~((uint64_t)1 << (LISTED_BIT(bp) % 64)))
+
+/*
+ * The incremental checker validates a slice of check_budget blocks every
+ * CHECK_PERIOD locked operations, walking the heap from check_cursor and
+ * starting over at the prologue after the epilogue.  Checking a slice at
+ * once keeps consecutive blocks together while they share cache lines.  A
+ * block that is merged into a lower one moves the cursor there, and the
+ * compactor's cursor likewise, so both always rest on a block boundary.
+ */
+#define CHECK_PERIOD  64
+#define CHECK_STEP()  do {                                                 \
+	if (check_budget > 0 && ++ms->check_ops >= CHECK_PERIOD) {         \
+		checkstep(check_budget);                                   \
+		ms->check_ops = 0;                                         \
+	}                                                                  \
+} while (0)
+#define CURSOR_ABSORB(bp, into)  do {                                      \
+	if (ms->check_cursor == (char *)(bp))                              \
+		ms->check_cursor = (char *)(into);                         \
+	if (ms->compact_cursor == (char *)(bp))                            \
+		ms->compact_cursor = (char *)(into);                       \
+} while (0)
+
+/*
+ * Event counters for mm_stats() are only kept when built with MM_STATS.
+ * They are updated under the heap lock.  STAT_SEARCH buckets a search
+ * length "n" by its bit length.
+ */
+#ifdef MM_STATS
+#define STAT_INC(field)  (ms->stat_counts.field++)
+#else
+#define STAT_INC(field)  ((void)0)
+#endif
+#define STAT_SEARCH(n)  STAT_INC(search_hist[(n) == 0 ? 0 :                \
+    MIN(32 - __builtin_clz((unsigned)(n)), MM_STATS_SEARCH - 1)])
+
+_Static_assert(SEGLST_MAX_LISTS <= MM_STATS_CLASSES,
+    "MM_STATS_CLASSES is too small for the size classes");
+
+/*
+ * The state of a heap: its free lists, bins, slabs, and checker cursor.
+ * Without MM_ARENAS there is a single heap, whose state is arenas[0].
+ */
+struct mstate {
+	char *heap_listp;         /* Pointer to first block */
+	void **seg_lst;           /* The segregated free lists */
+	uint64_t seg_map[SEGLST_MAP_WORDS]; /* Lists that are not empty */
+	void *fast_bins[FAST_BINS]; /* The fast bins, by block size in words */
+	int fast_count;           /* The number of blocks in all fast bins */
+	struct slab *slab_lst[SLAB_CLASSES]; /* Slabs with a free object */
+	struct side_index side[SIDE_LISTS]; /* Heads of the second-level lists */
+	/* Where each list's next search starts under next fit, or NULL */
+	struct free_block_body *rover[SEGLST_MAX_LISTS];
+	/* The free block that ends the heap, kept off the lists, or NULL */
+	char *top;
+	int listed_count;         /* The number of blocks on the lists */
+	/* The heap from here up is zero but for the tags and links of free
+	 * blocks: it has not been handed out since memlib provided it */
+	char *zero_lo;
+	unsigned long zero_skips;  /* Times it skipped over dirty memory */
+	/* The next block and seglist for the incremental checker; a NULL
+	 * block starts a new pass over the heap */
+	char *check_cursor;
+	int check_lst;
+	int check_ops;            /* Operations since the last checker slice */
+	/* The next block for the compactor; NULL starts a new pass */
+	char *compact_cursor;
+	struct mm_handle *free_handles; /* Handles not in use */
+	struct slab *nursery;     /* The nursery chunk to bump, or NULL */
+	struct slab *nursery_spare; /* Empty nursery chunks, by next */
+	int nursery_spares;       /* The number of empty nursery chunks */
+	/* Allocations so far, which lifetimes are measured in, the
+	 * lifetime score of each nursery size and the sampled blocks */
+	size_t life_clock;
+	unsigned life_count;
+	signed char life_score[LIFE_CLASSES];
+	struct life_sample life_samples[LIFE_SAMPLES];
+#ifdef MM_STATS
+	struct mm_stats stat_counts; /* The event counters */
+#endif
+#ifdef MM_THREADS
+	pthread_mutex_t lock;     /* Protects everything above */
+#endif
+#ifdef MM_ARENAS
+	char *lo;                 /* Start of the arena's region, or NULL */
+	char *brk;                /* End of the arena's heap */
+	char *max;                /* End of the arena's region */
+	void *remote;             /* Blocks freed by threads of other arenas */
+#endif
+};
 
 /* Global variables: */
-static char *heap_listp; /* Pointer to first block */  
+static char *heap_base;  /* Start of the heap, which free links are relative to */
+
+#ifdef MM_ARENAS
+/*
+ * Multi-arena mode: threads are assigned to NARENAS heaps round robin, each
+ * with its own lock, so threads of different arenas never contend.  The
+ * main arena is the memlib heap; every other arena reserves a region of
+ * ARENA_HEAP bytes from memlib when its first thread arrives and grows its
+ * heap within it.  A map of the heap's pages tells which arena owns a
+ * block.  A thread that frees a block of another arena pushes it on that
+ * arena's remote free queue without locking, and the arena's threads free
+ * the queued blocks on their next allocation.  An arena whose region is
+ * full allocates from the main arena instead.  These arenas are unrelated
+ * to those of mm_arena_create().
+ */
+#ifndef NARENAS
+#define NARENAS     4                   /* Number of heaps */
+#endif
+#define ARENA_HEAP  (MAX_HEAP / 8)      /* Bytes reserved per other arena */
+
+#ifndef MM_THREADS
+#error "MM_ARENAS requires MM_THREADS"
+#endif
+#if NARENAS > 255
+#error "NARENAS must fit in the page owner map"
+#endif
+
+static struct mstate arenas[NARENAS] = {
+	[0 ... NARENAS - 1] = { .lock = PTHREAD_MUTEX_INITIALIZER }
+};
+static __thread struct mstate *ms;  /* The arena the thread works on */
+static unsigned next_arena;         /* The arena for the next new thread */
+/* The index of the arena that owns each heap page */
+static uint8_t arena_pages[SLAB_PAGES];
+
+static struct mstate *arena_self(void);
+static struct mstate *arena_of(void *bp);
+static bool arena_setup(struct mstate *m);
+static void remote_free(struct mstate *m, void *bp);
+static void remote_drain(void);
+#else
+#define NARENAS  1
+#ifdef MM_THREADS
+static struct mstate arenas[NARENAS] = {
+	{ .lock = PTHREAD_MUTEX_INITIALIZER }
+};
+#else
+static struct mstate arenas[NARENAS];
+#endif
+#define ms  (&arenas[0])                /* The only heap */
+#endif
+
+#ifdef MM_THREADS
+/*
+ * Thread-safe mode: each heap's lock protects it and its segregated lists,
+ * and every thread keeps a cache of recently freed blocks for each block
+ * size in front of them.  Most small malloc/free pairs are served from the
+ * cache without taking the lock; only batch refills and flushes go to the
+ * shared lists.  Cached blocks stay marked as allocated in the heap, so
+ * they are never coalesced while they sit in a cache.  Blocks and slab
+ * objects share the bins, which are indexed by payload size.
+ */
+#define TCACHE_MAX    512                     /* Largest cached payload */
+#define TCACHE_BINS   (TCACHE_MAX / WSIZE + 1) /* One bin per payload size */
+#define TCACHE_BATCH  8   /* Blocks moved per refill or flush */
+#define TCACHE_LIMIT  16  /* Most blocks a single bin may hold */
+
+struct tcache {
+	unsigned long gen;         /* Heap generation of the cached blocks */
+	void *bins[TCACHE_BINS];   /* Singly linked through the first word */
+	int counts[TCACHE_BINS];   /* Number of blocks in each bin */
+#ifdef MM_ARENAS
+	struct mstate *arena;      /* The arena the thread allocates from */
+#endif
+};
+
+static pthread_once_t tcache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t tcache_key;
+static unsigned long heap_gen;          /* Bumped by every mm_init */
+static __thread struct tcache tcache;
+
+#define LOCK()    pthread_mutex_lock(&ms->lock)
+#define UNLOCK()  pthread_mutex_unlock(&ms->lock)
+
+static struct tcache *tcache_self(void);
+static bool tcache_put(struct tcache *tc, void *bp);
+static void tcache_flush(struct tcache *tc, size_t idx, int count);
+static void tcache_key_init(void);
+static void tcache_destroy(void *arg);
+#else
+#define LOCK()
+#define UNLOCK()
+#endif
 
 /* Function prototypes for internal helper routines: */
+static int heap_setup(void);
+static void *heap_sbrk(intptr_t incr);
+static char *heap_end(void);
+static void *do_malloc(size_t size);
+static void *do_malloc_hint(size_t size, int hint);
+static void *do_malloc_near(void *ptr, size_t size);
+static void do_free(void *bp);
+static void free_block(void *bp);
+static void consolidate(void);
+static void *do_realloc(void *ptr, size_t size);
+static size_t do_trim(size_t pad);
+static void *realloc_backward(void *ptr, size_t avail, size_t slack_asize,
+    size_t asize);
+static size_t adjust_size(size_t size);
 static void *coalesce(void *bp);
 static void *extend_heap(size_t words);
+static void *grow_top(size_t asize);
 static void *find_fit(size_t asize);
+static void *heap_malloc(size_t asize);
+static void slide(void *hole);
 static void *place(void *bp, size_t asize);
-static void *find_block_from_list(struct free_block_body *bp, int asize);
+static size_t place_batch(size_t n, size_t asize, void **out);
+static int addr_cmp(const void *a, const void *b);
+static void mark_used(void *bp);
+static void zero_absorbed(void *bp, size_t size);
+static void *find_block_from_list(struct free_block_body *bp, int asize,
+    int limit);
 
 static void insert_block(void *bp, int size);
 static void delete_block(void *bp);
 static int get_list_index(int size);
+static size_t class_size(int lst_indx);
+static int find_nonempty_list(int lst_indx);
+static struct free_tree_node *tree_splay(struct free_tree_node *t,
+    size_t size, void *addr);
+static void *tree_best_fit(int lst_indx, size_t asize);
+static void tree_insert(int lst_indx, void *bp);
+static void tree_delete(int lst_indx, void *bp);
+static void side_insert(int lst_indx, void *bp, int size);
+static void side_delete(int lst_indx, void *bp);
+static void *side_fit(int lst_indx, size_t asize);
+static void link_head(int lst_indx, void *bp, int size);
+static void link_ordered(int lst_indx, void *bp, int size);
+static void *fit_first(int lst_indx, size_t asize);
+static void *fit_next(int lst_indx, size_t asize);
+static void *fit_best(int lst_indx, size_t asize);
+static void *near_fit(void *anchor, size_t asize);
+
+static void *alloc_aligned(size_t asize, size_t align);
+static char *aligned_payload(void *bp, size_t align);
+static char *aligned_fit(void *bp, size_t asize, size_t align);
+static void *slab_malloc(size_t size);
+static void *slab_take(struct slab *sp);
+static void slab_free(void *bp);
+static bool is_slab(void *bp);
+static void slab_unlink(struct slab *sp);
+static struct slab *slab_new(void);
+static void slab_release(struct slab *sp);
+static void *nursery_malloc(size_t asize);
+static void nursery_free(void *bp);
+static void life_birth(void *bp, size_t asize);
+static void life_death(void *bp);
+static void life_forget(void *bp);
+static void life_train(int cls, bool short_lived);
+static void *map_alloc(size_t size, size_t align);
+static void map_free(void *bp);
+static size_t map_usable_size(void *bp);
+static size_t usable_size(void *bp);
+static void *arena_grow(struct mm_arena *arena, size_t size);
 
 /* Function prototypes for heap consistency checker routines: */
 static void checkblock(void *bp);
+static void checkzero(void *bp);
 static void checkheap(bool verbose);
 static void printblock(void *bp); 
 static void printlist(int lstIndx);
 static void checklist();
 static void checkfreeblock(void *bp);
+static void checkstep(size_t budget);
+static void checklinks(void *bp);
+static bool is_listed(void *bp);
+static int checktree(struct free_tree_node *t, void *lo, void *hi,
+    int lst_indx);
+static void printtree(struct free_tree_node *t);
+static void checkslab(struct slab *sp);
+static void checknursery(struct slab *sp);
+static void checkside(int lst_indx);
 
-/* The segregated free lists */
-static void **seg_lst;
+/* The active geometry of the lists, and the size the heap grows by */
+static int seglst_num, seglst_small, seglst_lists, tree_lst, side_lst;
+static size_t low_bound, chunk_size;
+/* The geometry and growth size mm_init() sets up */
+static int opt_seglst_num = SEGLST_NUM;
+static size_t opt_low_bound = LOW_BOUND;
+static size_t opt_chunk_size = CHUNKSIZE;
+static int opt_policy = MM_POLICY_LIFO;
+/* The placement policies, and the active one */
+static const struct fit_policy policies[MM_POLICIES] = {
+	[MM_POLICY_LIFO] = { link_head, fit_first },
+	[MM_POLICY_NEXT] = { link_head, fit_next },
+	[MM_POLICY_BEST] = { link_head, fit_best },
+	[MM_POLICY_ADDRESS] = { link_ordered, fit_first },
+};
+static const struct fit_policy *policy = &policies[MM_POLICY_LIFO];
+/* Bitmap of the heap pages that hold a slab */
+static uint64_t slab_pages[(SLAB_PAGES + 63) / 64];
+/* Page number of the first heap page */
+static uintptr_t slab_base_page;
+/* Bitmap of the blocks on the segregated lists of every heap */
+static uint64_t listed_map[LISTED_WORDS];
+/* Bitmap of the blocks the compactor may move */
+static uint64_t handle_map[LISTED_WORDS];
+/* The number of blocks the incremental checker validates per period */
+static size_t check_budget;
+/* The size of a free block at the heap's end that triggers trimming */
+static size_t trim_threshold = TRIM_THRESHOLD;
+/* The smallest request that is served from a region of its own */
+static size_t mmap_threshold = MMAP_THRESHOLD;
+/* Whether blocks are placed by their predicted lifetime */
+static bool predict_lifetime = true;
 /* flag for debugging */
 static bool debug_flag = false;
 static bool check_block_flag = false;
@@ -124,28 +792,53 @@ mm_init(void)
 		printf("********========+++++++++##############\n");
 		printf("MM_INIT: \n");
 	}
+	int err;
+#ifdef MM_ARENAS
 	int i;
-	/* Create the initial empty heap. */
-	if ((heap_listp = mem_sbrk((4 + SEGLST_NUM) * WSIZE)) == (void *)-1)
-		return (-1);
-
-	seg_lst = (void **)heap_listp;
 
-	for (i = 0; i < SEGLST_NUM; i ++) {
-		seg_lst[i] = NULL;
+	ms = &arenas[0];
+#endif
+	LOCK();
+#ifdef MM_THREADS
+	/* Blocks still cached by any thread belong to the old heap. */
+	__atomic_add_fetch(&heap_gen, 1, __ATOMIC_RELEASE);
+#endif
+	/* Set up the geometry of the segregated lists. */
+	seglst_num = opt_seglst_num;
+	low_bound = opt_low_bound;
+	chunk_size = opt_chunk_size;
+	seglst_small = (int)(low_bound / ALIGN_SIZE);
+	seglst_lists = seglst_small + (seglst_num - 1) * SEGLST_SUB;
+	tree_lst = seglst_small +
+	    (__builtin_ctz(TREE_MIN) - __builtin_ctzl(low_bound)) * SEGLST_SUB;
+	side_lst = opt_policy == MM_POLICY_LIFO ?
+	    MIN(tree_lst, seglst_lists - 1) : seglst_small;
+	policy = &policies[opt_policy];
+	/* The bitmaps start out clear, so only a later mm_init clears them. */
+	if (heap_base != NULL) {
+		memset(slab_pages, 0, sizeof(slab_pages));
+		memset(listed_map, 0, sizeof(listed_map));
+		memset(handle_map, 0, sizeof(handle_map));
+#ifdef MM_ARENAS
+		memset(arena_pages, 0, sizeof(arena_pages));
+#endif
 	}
-	/* Alignment padding */
-	PUT(heap_listp + (SEGLST_NUM * WSIZE), 0);                           
-	/* Prologue header */ 
-	PUT(heap_listp + ((SEGLST_NUM + 1) * WSIZE), PACK(DSIZE, 1)); 
-	/* Prologue footer */ 
-	PUT(heap_listp  + ((SEGLST_NUM + 2) * WSIZE), PACK(DSIZE, 1));
-	/* Epilogue header */ 
-	PUT(heap_listp + ((SEGLST_NUM + 3) * WSIZE), PACK(0, 1));      
-	
-	heap_listp += (SEGLST_NUM + 2) * WSIZE; 
-
-	return (0);
+	slab_base_page = (uintptr_t)mem_heap_lo() / SLAB_SIZE;
+	heap_base = (char *)mem_heap_hi() + 1;
+#ifdef MM_ARENAS
+	/* The other arenas set up their heaps when their first thread comes. */
+	for (i = 1; i < NARENAS; i++) {
+		arenas[i].heap_listp = NULL;
+		arenas[i].remote = NULL;
+	}
+	ms->lo = NULL;
+	ms->remote = NULL;
+	next_arena = 0;
+#endif
+	/* Create the initial empty heap. */
+	err = heap_setup();
+	UNLOCK();
+	return (err);
 }
 
 /* 
@@ -160,89 +853,125 @@ mm_init(void)
 void *
 mm_malloc(size_t size) 
 {
-	if (debug_flag) {
-		printf("********========+++++++++##############\n");
-		printf("MM_MALLOC: ");
-		printf("Malloc size of: %d bytes, %d words\n", (int)size, (int)size / 8); 
-	}
-	if (debug_flag) {
-		printf("mm_malloc: print list 4\n");
-		struct free_block_body *temp = seg_lst[4];
-		if (temp != NULL)
-			printblock(temp);
-	}
-	size_t asize;      /* Adjusted block size */
-	size_t extendsize; /* Amount to extend heap if no fit */
+
+	return (mm_malloc_hint(size, MM_HINT_NONE));
+}
+
+/* 
+ * Requires:
+ *   "hint" is one of the MM_HINT_ values.
+ *
+ * Effects:
+ *   Allocate a block like mm_malloc(), placing it by "hint" instead of by
+ *   its predicted lifetime unless "hint" is MM_HINT_NONE.  A block hinted
+ *   to be short-lived is kept apart from the long-lived ones if it is
+ *   small enough for the nursery.
+ */
+void *
+mm_malloc_hint(size_t size, int hint)
+{
 	void *bp;
 
-	/* Ignore spurious requests. */
-	if (size == 0)
+	/* Ignore spurious requests and ones no heap could satisfy. */
+	if (size == 0 || size > MAX_HEAP)
 		return (NULL);
+#ifdef MM_ARENAS
+	ms = arena_self();
+#endif
+#ifdef MM_THREADS
+	struct tcache *tc = NULL;
+	size_t psize;
+	int i;
 
-	/* Adjust block size to include overhead and alignment reqs. */
-	if (size <= DSIZE) 
-		asize = 2 * DSIZE;
-	else 
-		if (size % WSIZE == 0)
-			asize = DSIZE + size;
-		else
-			asize = DSIZE + (((size / WSIZE) + 1) * WSIZE);
-	/* case for trace file realloc-bal.rep */
-	if ((size % 128 == 0) && (size != 128)) {
-		asize = DSIZE + size + 128;
-	}
-	/* case for trace file realloc2-bal.rep */
-	if (size == 4092) {
-		asize = DSIZE + 4104;
-	}
-	/* case for trace file binary-bal.rep */
-	//if (size == 64) {
-	//	asize = DSIZE + 544;
-	//}
-	/* Search the free list for a fit. */
-	if (check_block_flag) {
-		printf("mm_malloc: start check_block_flag\n");
-		checkheap(false);
-		checklist();
-		printf("mm_malloc: end check_block_flag\n");
+	/* The payload size a fresh allocation of "size" bytes would get */
+	if (size <= SLAB_MAX)
+		psize = ALIGN_UP(size);
+	else
+		psize = adjust_size(size) - WSIZE;
+	/* A cached block may have been placed for another lifetime. */
+	if (psize <= TCACHE_MAX && hint == MM_HINT_NONE) {
+		tc = tcache_self();
+		if ((bp = tc->bins[psize / WSIZE]) != NULL) {
+			tc->bins[psize / WSIZE] = *(void **)bp;
+			tc->counts[psize / WSIZE]--;
+			return (bp);
+		}
 	}
-	
-	if ((bp = find_fit(asize)) != NULL) {
-		if (debug_flag)
-			printf("mm_malloc: place the block into a seglst\n");
-		bp = place(bp, asize);
-		return (bp);
+#endif
+	LOCK();
+#ifdef MM_ARENAS
+	if (__atomic_load_n(&ms->remote, __ATOMIC_RELAXED) != NULL)
+		remote_drain();
+#endif
+	bp = do_malloc_hint(size, hint);
+#ifdef MM_ARENAS
+	/* This arena's region is full: fall back on the main arena. */
+	if (bp == NULL && ms != &arenas[0]) {
+		UNLOCK();
+		ms = &arenas[0];
+		LOCK();
+		bp = do_malloc_hint(size, hint);
 	}
+#endif
+#ifdef MM_THREADS
+	/* Refill the cache with a batch of blocks of this size. */
+	for (i = 1; tc != NULL && bp != NULL && i < TCACHE_BATCH; i++) {
+		void *extra = do_malloc(size);
 
-	/* No fit found. Get more memory and place the block. */
-	extendsize = MAX(asize, CHUNKSIZE);
-	/* case for trace file realloc-bal.rep */
-	if (size == 512) {
-		asize = 640 + 16;
-	}
-	/* case for trace file realloc2-bal.rep */
-	if (size == 4092) {
-		extendsize = 4280;
+		if (extra == NULL)
+			break;
+		if (!tcache_put(tc, extra))
+			do_free(extra);
 	}
-	if (size == 16) {
-		extendsize = 128;
-	}
-	if (debug_flag)
-		printf("mm_malloc: No fit found. Get more memory and place the block.\n"
-			"The extend block size: %d bytes\n", (int)extendsize);
-	if (extendsize % WSIZE != 0)
-		extendsize = ((extendsize / WSIZE) + 1) * WSIZE;
-	if ((bp = extend_heap(extendsize / WSIZE)) == NULL)  
-		return (NULL);
-	bp = place(bp, asize);
-	if (debug_flag) {
-		printf("mm_malloc: after malloc print list 4\n");
-		struct free_block_body *temp = seg_lst[4];
-		if (temp != NULL)
-			printblock(temp);
+#endif
+	CHECK_STEP();
+	UNLOCK();
+	return (bp);
+}
+
+/* 
+ * Requires:
+ *   "ptr" is either the address of an allocated block or NULL.
+ *
+ * Effects:
+ *   Allocate a block like mm_malloc(), but close to the block "ptr" if
+ *   there is room nearby, so that linked structures stay together.  The
+ *   free blocks next to "ptr" are tried first, then the ones nearest to
+ *   it among the first few of the lists that fit.  A block of another
+ *   arena, or one with a region of its own, has no neighbors to offer.
+ */
+void *
+mm_malloc_near(void *ptr, size_t size)
+{
+	void *bp;
+
+	/* Without a block to be near, this is a plain allocation. */
+	if (ptr == NULL || size == 0 || size > MAX_HEAP)
+		return (mm_malloc(size));
+#ifdef MM_ARENAS
+	ms = arena_self();
+	if (arena_of(ptr) != ms)
+		return (mm_malloc(size));
+#endif
+	LOCK();
+#ifdef MM_ARENAS
+	if (__atomic_load_n(&ms->remote, __ATOMIC_RELAXED) != NULL)
+		remote_drain();
+#endif
+	bp = do_malloc_near(ptr, size);
+#ifdef MM_ARENAS
+	/* This arena's region is full: fall back on the main arena. */
+	if (bp == NULL && ms != &arenas[0]) {
+		UNLOCK();
+		ms = &arenas[0];
+		LOCK();
+		bp = do_malloc(size);
 	}
+#endif
+	CHECK_STEP();
+	UNLOCK();
 	return (bp);
-} 
+}
 
 /* 
  * Requires:
@@ -254,27 +983,44 @@ mm_malloc(size_t size)
 void
 mm_free(void *bp)
 {
-	size_t size;
 	/* Ignore spurious requests. */
 	if (bp == NULL)
 		return;
-	/* Free and coalesce the block. */
-	size = GET_SIZE(HDRP(bp));
+#ifdef MM_THREADS
+	struct tcache *tc;
+	size_t size = usable_size(bp);
+#ifdef MM_ARENAS
+	struct mstate *owner;
 
-	if (debug_flag) {
-		printf("########***********=======+++++++=======\n");
-		printf("MM_FREE: ");
-		printf("mm_free: Freeing size %d\n", (int)size);
+	ms = arena_self();
+#endif
+
+	/* Blocks that grew by realloc skip the cache to drop their mark. */
+	if (size <= TCACHE_MAX &&
+	    (is_slab(bp) || !GET_REALLOCED(HDRP(bp)))) {
+		tc = tcache_self();
+		if (tcache_put(tc, bp))
+			return;
+		/* The bin is full: give half of it back to the shared lists. */
+		LOCK();
+		tcache_flush(tc, size / WSIZE, TCACHE_LIMIT / 2);
+		CHECK_STEP();
+		UNLOCK();
+		tcache_put(tc, bp);
+		return;
 	}
-	PUT(HDRP(bp), PACK(size, 0));
-	PUT(FTRP(bp), PACK(size, 0));
-	if (debug_flag) {
-		printf("mm_free: middle: print list 5\n");
-		printlist(5);
+#endif
+#ifdef MM_ARENAS
+	/* A block of another arena goes on that arena's remote free queue. */
+	if ((owner = arena_of(bp)) != NULL && owner != ms) {
+		remote_free(owner, bp);
+		return;
 	}
-	insert_block(bp, size);
-
-	coalesce(bp);
+#endif
+	LOCK();
+	do_free(bp);
+	CHECK_STEP();
+	UNLOCK();
 }
 
 /*
@@ -293,12 +1039,6 @@ mm_free(void *bp)
 void *
 mm_realloc(void *ptr, size_t size)
 {
-	if (debug_flag) {
-		printf("*******+++++++============********\n");
-		printf("MM_REALLOC: ");
-		printf("mm_realloc: realloc to size of: %d\n", (int)size);
-	}
-	size_t oldsize;
 	void *newptr;
 
 	/* If size == 0 then this is just free, and we return NULL. */
@@ -309,601 +1049,3415 @@ mm_realloc(void *ptr, size_t size)
 	/* If oldptr is NULL, then this is just malloc. */
 	if (ptr == NULL)
 		return (mm_malloc(size));
-	/* align size to multiples of WSIZE */
-	int new_size = (int)size;
-	if (new_size % WSIZE != 0) 
-		new_size = ((new_size / WSIZE) + 1) * WSIZE;
-	int realloc_asize = new_size + (int)DSIZE;
-	/* size of previously allocated block */
-	oldsize = GET_SIZE(HDRP(ptr));
-	int size_diff = (int)(oldsize - realloc_asize);
-
-	if (debug_flag) {
-		printf("mm_realloc: new_size: %d\n", new_size);
-		printf("mm_realloc: oldsize: %d\n", (int)oldsize);
-		printf("mm_realloc: realloc_asize: %d\n", realloc_asize);
-		printf("mm_realloc: size_diff: %d\n", size_diff);
-	}
-
-	if (realloc_asize == (int)oldsize) {
-		if (debug_flag) { 
-			printf("mm_realloc: realloc_asize == oldsize\n");
-		}
-		return (ptr);
+	if (size > MAX_HEAP)
+		return (NULL);
+#ifdef MM_ARENAS
+	/* Resize the block under the lock of the arena that owns it. */
+	if ((ms = arena_of(ptr)) == NULL)
+		ms = arena_self();
+#endif
+	LOCK();
+	newptr = do_realloc(ptr, size);
+	if (newptr == ptr)
+		STAT_INC(realloc_inplace);
+	else if (newptr != NULL)
+		STAT_INC(realloc_copy);
+	CHECK_STEP();
+	UNLOCK();
+#ifdef MM_ARENAS
+	/* The owner's region is full: move the block to another arena. */
+	if (newptr == NULL && (newptr = mm_malloc(size)) != NULL) {
+		memcpy(newptr, ptr, MIN(size, usable_size(ptr)));
+		mm_free(ptr);
 	}
-	/* new size required is less than previous allocated size */
-	else if (size_diff > 0) {
-		/* new size required is less than previous allocated size, 
-	 	 * and size in difference can form a new block */
-		if (size_diff >= (int)(2 * DSIZE)) {
-			if (debug_flag) { 
-				printf("mm_realloc: size_diff >= (int)(2 * DSIZE)\n");
-			}
-			PUT(HDRP(ptr), PACK(realloc_asize, 1));
-			PUT(FTRP(ptr), PACK(realloc_asize, 1)); 
+#endif
+	return (newptr);
+}
 
-			ptr = NEXT_BLKP(ptr);
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a block with at least "size" bytes of payload whose address
+ *   is a multiple of "align", a power of two.  The free space in front of
+ *   the payload goes back to the free lists.  Returns the address of this
+ *   block if the allocation was successful and NULL otherwise.
+ */
+void *
+mm_memalign(size_t align, size_t size)
+{
+	void *bp;
 
-			PUT(HDRP(ptr), PACK(size_diff, 0));
-			PUT(FTRP(ptr), PACK(size_diff, 0));
+	if (size == 0 || size > MAX_HEAP || align == 0 || align > MAX_HEAP ||
+	    (align & (align - 1)) != 0)
+		return (NULL);
+	if (align <= ALIGN_SIZE)
+		return (mm_malloc(size));
+#ifdef MM_ARENAS
+	ms = arena_self();
+#endif
+	LOCK();
+	/* Huge blocks get a region of their own, if one can be mapped. */
+	if (size < mmap_threshold || align > mem_pagesize() ||
+	    (bp = map_alloc(size, align)) == NULL)
+		bp = alloc_aligned(adjust_size(size), align);
+#ifdef MM_ARENAS
+	/* This arena's region is full: fall back on the main arena. */
+	if (bp == NULL && ms != &arenas[0]) {
+		UNLOCK();
+		ms = &arenas[0];
+		LOCK();
+		bp = alloc_aligned(adjust_size(size), align);
+	}
+#endif
+	CHECK_STEP();
+	UNLOCK();
+	return (bp);
+}
 
-			insert_block(ptr, size_diff);
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Like mm_memalign(), but the payload is rounded up to a whole number of
+ *   "align" bytes, as C11 aligned_alloc() expects of its callers, so that
+ *   vector code can run over the whole buffer without a scalar tail.
+ */
+void *
+mm_aligned_alloc(size_t align, size_t size)
+{
 
-			coalesce(ptr);
+	if (align == 0 || (align & (align - 1)) != 0 || size > MAX_HEAP)
+		return (NULL);
+	return (mm_memalign(align, (size + align - 1) & ~(align - 1)));
+}
 
-			return (PREV_BLKP(ptr));
-		} 
-		/* new size required is less than previous allocated size, 
-	 	 * but size in difference cannot form a new block */
-		else {
-			if (debug_flag) { 
-				printf("mm_realloc: size_diff < (int)(2 * DSIZE)\n");
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a block for "nmemb" elements of "size" bytes each and clear
+ *   it.  A block carved from the zero tail of the heap, which memlib has
+ *   just provided, only needs the links and footer it held while free
+ *   cleared.  Returns the address of this block if the allocation was
+ *   successful and NULL otherwise.
+ */
+void *
+mm_calloc(size_t nmemb, size_t size)
+{
+	char *zero_lo;
+	unsigned long skips;
+	size_t total;
+	void *bp;
+	bool zero;
+
+	if (__builtin_mul_overflow(nmemb, size, &total) || total == 0 ||
+	    total > MAX_HEAP)
+		return (NULL);
+	/* A small block is most likely a reused one: clear it outright. */
+	if (total < CALLOC_MIN) {
+		if ((bp = mm_malloc(total)) != NULL)
+			memset(bp, 0, total);
+		return (bp);
+	}
+#ifdef MM_ARENAS
+	ms = arena_self();
+#endif
+	LOCK();
+	zero_lo = ms->zero_lo;
+	skips = ms->zero_skips;
+	bp = do_malloc(total);
+#ifdef MM_ARENAS
+	/* This arena's region is full: fall back on the main arena. */
+	if (bp == NULL && ms != &arenas[0]) {
+		UNLOCK();
+		ms = &arenas[0];
+		LOCK();
+		zero_lo = ms->zero_lo;
+		skips = ms->zero_skips;
+		bp = do_malloc(total);
+	}
+#endif
+	/* The block is clean if it lies in the zero tail as it was before. */
+	zero = bp != NULL && !IS_MAPPED(bp) && (char *)bp >= zero_lo &&
+	    ms->zero_skips == skips;
+	CHECK_STEP();
+	UNLOCK();
+	if (bp == NULL)
+		return (NULL);
+	if (!zero)
+		memset(bp, 0, total);
+	else {
+		memset(bp, 0, MIN(LINKS_SIZE, GET_SIZE(HDRP(bp)) - WSIZE));
+		PUT(FTRP(bp), 0);
+	}
+	return (bp);
+}
+
+/*
+ * Requires:
+ *   "out" has room for "n" pointers.
+ *
+ * Effects:
+ *   Allocate up to "n" blocks with at least "size" bytes of payload each,
+ *   storing their addresses in "out", under a single acquisition of the
+ *   heap lock.  Heap blocks are carved side by side out of one free block,
+ *   so that the run costs one list operation.  Returns the number of
+ *   blocks allocated, which is less than "n" only if the heap is full.
+ */
+size_t
+mm_malloc_batch(size_t n, size_t size, void **out)
+{
+	size_t i = 0;
+
+	if (size == 0 || size > MAX_HEAP)
+		return (0);
+#ifdef MM_ARENAS
+	ms = arena_self();
+#endif
+	LOCK();
+#ifdef MM_ARENAS
+	if (__atomic_load_n(&ms->remote, __ATOMIC_RELAXED) != NULL)
+		remote_drain();
+#endif
+	if (size > SLAB_MAX && size < mmap_threshold)
+		i = place_batch(n, adjust_size(size), out);
+	while (i < n && (out[i] = do_malloc(size)) != NULL)
+		i++;
+#ifdef MM_ARENAS
+	/* This arena's region is full: fall back on the main arena. */
+	if (i < n && ms != &arenas[0]) {
+		UNLOCK();
+		ms = &arenas[0];
+		LOCK();
+		while (i < n && (out[i] = do_malloc(size)) != NULL)
+			i++;
+	}
+#endif
+	CHECK_STEP();
+	UNLOCK();
+	return (i);
+}
+
+/*
+ * Requires:
+ *   Each of the "n" entries of "ptrs" is NULL or the address of a
+ *   distinct allocated block.
+ *
+ * Effects:
+ *   Free every block in "ptrs" under a single acquisition of the heap
+ *   lock.  The heap blocks are gathered at the front of "ptrs" and sorted
+ *   by address, so that blocks that are neighbors on the heap come
+ *   together, and each such run is freed and coalesced as one block.
+ *   "ptrs" is left reordered.
+ */
+void
+mm_free_batch(size_t n, void **ptrs)
+{
+	char *bp;
+	size_t i, j, k, m, size;
+#ifdef MM_ARENAS
+	struct mstate *owner;
+
+	ms = arena_self();
+#endif
+
+	/* Move slab objects, mapped blocks and NULLs behind the rest. */
+	for (i = 0, m = n; i < m; ) {
+		bp = ptrs[i];
+		if (bp != NULL && !is_slab(bp) && !IS_MAPPED(bp)
+#ifdef MM_ARENAS
+		    && arena_of(bp) == ms
+#endif
+		    )
+			i++;
+		else {
+			ptrs[i] = ptrs[--m];
+			ptrs[m] = bp;
+		}
+	}
+	/* A batch from mm_malloc_batch() is usually in order already. */
+	for (i = 1; i < m && (uintptr_t)ptrs[i - 1] < (uintptr_t)ptrs[i]; i++)
+		;
+	if (i < m)
+		qsort(ptrs, m, sizeof(*ptrs), addr_cmp);
+	LOCK();
+	for (i = m; i < n; i++) {
+		if ((bp = ptrs[i]) == NULL)
+			continue;
+#ifdef MM_ARENAS
+		/* A block of another arena goes on that arena's queue. */
+		if ((owner = arena_of(bp)) != NULL && owner != ms) {
+			remote_free(owner, bp);
+			continue;
+		}
+#endif
+		do_free(bp);
+	}
+	for (i = 0; i < m; i = j) {
+		/* Take in the blocks of the batch that follow on the heap. */
+		bp = ptrs[i];
+		size = GET_SIZE(HDRP(bp));
+		for (j = i + 1; j < m && (char *)ptrs[j] == bp + size; j++) {
+			CURSOR_ABSORB(ptrs[j], bp);
+			size += GET_SIZE(HDRP(ptrs[j]));
+		}
+		if (j == i + 1) {
+			do_free(bp);
+			continue;
+		}
+		/* The predictor sees every block of the run die. */
+		for (k = i; predict_lifetime && k < j; k++)
+			life_death(ptrs[k]);
+		PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)) | ALLOC));
+		free_block(bp);
+	}
+	CHECK_STEP();
+	UNLOCK();
+}
+
+/*
+ * Requires:
+ *   "a" and "b" point to block addresses.
+ *
+ * Effects:
+ *   Compare the addresses for qsort().
+ */
+static int
+addr_cmp(const void *a, const void *b)
+{
+	uintptr_t x = (uintptr_t)*(void * const *)a;
+	uintptr_t y = (uintptr_t)*(void * const *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a movable block with at least "size" bytes of payload and
+ *   return a handle to it, or NULL on failure.  The block's address is
+ *   only known while the handle is pinned; the rest of the time
+ *   mm_compact() may move it.  Handles refer to blocks of the main heap,
+ *   which never come from a slab or a region of their own.
+ */
+struct mm_handle *
+mm_halloc(size_t size)
+{
+	struct mm_handle *h;
+	char *bp;
+	int i;
+
+	if (size == 0 || size > MAX_HEAP)
+		return (NULL);
+#ifdef MM_ARENAS
+	ms = &arenas[0];
+#endif
+	LOCK();
+	if (ms->free_handles == NULL && (h = mem_map(HANDLE_CHUNK *
+	    sizeof(struct mm_handle))) != (void *)-1) {
+		for (i = 0; i < HANDLE_CHUNK; i++) {
+			h[i].bp = ms->free_handles;
+			ms->free_handles = &h[i];
+		}
+	}
+	/* The block's last word points back to the handle. */
+	h = NULL;
+	if (ms->free_handles != NULL &&
+	    (bp = heap_malloc(adjust_size(size + WSIZE))) != NULL) {
+		h = ms->free_handles;
+		ms->free_handles = h->bp;
+		h->bp = bp;
+		h->pins = 0;
+		SET_HANDLE_OF(bp, h);
+		SET_HANDLE(bp);
+	}
+	CHECK_STEP();
+	UNLOCK();
+	return (h);
+}
+
+/*
+ * Requires:
+ *   "h" is NULL or a handle from mm_halloc() that is not pinned.
+ *
+ * Effects:
+ *   Free the handle and its block.
+ */
+void
+mm_hfree(struct mm_handle *h)
+{
+
+	if (h == NULL)
+		return;
+#ifdef MM_ARENAS
+	ms = &arenas[0];
+#endif
+	LOCK();
+	CLEAR_HANDLE(h->bp);
+	do_free(h->bp);
+	h->bp = ms->free_handles;
+	ms->free_handles = h;
+	CHECK_STEP();
+	UNLOCK();
+}
+
+/*
+ * Requires:
+ *   "h" is a handle from mm_halloc().
+ *
+ * Effects:
+ *   Pin the handle's block in place and return its address, which stays
+ *   valid until a matching call to mm_hunpin().  Pins nest.
+ */
+void *
+mm_hpin(struct mm_handle *h)
+{
+	void *bp;
+
+#ifdef MM_ARENAS
+	ms = &arenas[0];
+#endif
+	LOCK();
+	h->pins++;
+	bp = h->bp;
+	UNLOCK();
+	return (bp);
+}
+
+/*
+ * Requires:
+ *   "h" is a handle pinned by mm_hpin().
+ *
+ * Effects:
+ *   Undo one call to mm_hpin(), letting the block move again once none
+ *   are left.
+ */
+void
+mm_hunpin(struct mm_handle *h)
+{
+
+#ifdef MM_ARENAS
+	ms = &arenas[0];
+#endif
+	LOCK();
+	h->pins--;
+	UNLOCK();
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Compact the main heap incrementally.  Walking up from where the last
+ *   call stopped, slide every unpinned movable block that follows a free
+ *   block down into it, so that the free space bubbles up and merges as
+ *   it goes.  A call stops once it has walked or moved "budget" bytes;
+ *   at the epilogue a pass is done, and the free space the heap ends with
+ *   is returned to memlib.  Returns the number of bytes moved.
+ */
+size_t
+mm_compact(size_t budget)
+{
+	char *bp, *next;
+	size_t moved = 0, seen = 0, size;
+
+#ifdef MM_ARENAS
+	ms = &arenas[0];
+#endif
+	LOCK();
+	if (ms->heap_listp == NULL) {
+		UNLOCK();
+		return (0);
+	}
+#ifdef MM_ARENAS
+	remote_drain();
+#endif
+	/* Blocks in the fast bins would pin the space around them. */
+	consolidate();
+	bp = ms->compact_cursor;
+	if (bp == NULL)
+		bp = NEXT_BLKP(ms->heap_listp);
+	while (seen < budget && (size = GET_SIZE(HDRP(bp))) != 0) {
+		next = NEXT_BLKP(bp);
+		if (!GET_ALLOC(HDRP(bp)) && GET_SIZE(HDRP(next)) != 0 &&
+		    GET_HANDLE(next) && HANDLE_OF(next)->pins == 0) {
+			size = GET_SIZE(HDRP(next));
+			slide(bp);
+			moved += size;
+		}
+		seen += size;
+		bp = NEXT_BLKP(bp);
+	}
+	ms->compact_cursor = bp;
+	if (GET_SIZE(HDRP(bp)) == 0) {
+		ms->compact_cursor = NULL;
+		do_trim(0);
+	}
+	CHECK_STEP();
+	UNLOCK();
+	return (moved);
+}
+
+/*
+ * Requires:
+ *   "hole" is the address of a free block that is followed by an
+ *   unpinned movable block.  In thread-safe mode, the caller holds the
+ *   heap lock.
+ *
+ * Effects:
+ *   Move the block that follows "hole" down to the address of "hole",
+ *   repointing its handle, and free the space left above it, which
+ *   coalesces with the block after, if that is free.
+ */
+static void
+slide(void *hole)
+{
+	char *bp = NEXT_BLKP(hole);
+	char *rest;
+	size_t gap = GET_SIZE(HDRP(hole));
+	size_t size = GET_SIZE(HDRP(bp));
+	struct mm_handle *h = HANDLE_OF(bp);
+
+	delete_block(hole);
+	CURSOR_ABSORB(bp, hole);
+	if (predict_lifetime)
+		life_forget(bp);
+	memmove(hole, bp, size - WSIZE);
+	PUT(HDRP(hole), PACK(size, GET_PREV_ALLOC(HDRP(hole)) | ALLOC));
+	CLEAR_HANDLE(bp);
+	SET_HANDLE(hole);
+	h->bp = hole;
+	rest = NEXT_BLKP(hole);
+	PUT(HDRP(rest), PACK(gap, PREV_ALLOC | ALLOC));
+	free_block(rest);
+}
+
+/*
+ * Requires:
+ *   "ptr" is the address of an allocated block.
+ *
+ * Effects:
+ *   Return the number of bytes of payload the block "ptr" has, which may
+ *   be more than were requested.
+ */
+size_t
+mm_usable_size(void *ptr)
+{
+
+	return (usable_size(ptr));
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Set the tunable "option" to "value".  MM_OPT_TRIM_THRESHOLD sets the
+ *   size a free block at the end of the heap must reach before mm_free
+ *   trims it.  MM_OPT_MMAP_THRESHOLD sets the smallest request that gets
+ *   a region of its own, but never below a page.  MM_OPT_CHECK_BUDGET
+ *   sets how many blocks the incremental checker validates every
+ *   CHECK_PERIOD calls to malloc, free or realloc that take the heap lock,
+ *   or turns it off if zero.  MM_OPT_LIFETIME turns placement by predicted
+ *   lifetime on if one, the default, and off if zero.
+ *
+ *   MM_OPT_SEGLST_NUM and MM_OPT_LOW_BOUND set the number of first-level
+ *   size classes and the smallest size they start at, a power of two up
+ *   to TREE_MIN.  MM_OPT_CHUNKSIZE sets the least the heap grows by.
+ *   MM_OPT_POLICY sets the placement policy, one of the MM_POLICY_
+ *   values.  These four take effect at the next mm_init().
+ *
+ *   Returns 0 if the option was set and -1 if it is unknown or "value" is
+ *   out of range.
+ */
+int
+mm_setopt(int option, size_t value)
+{
+	int err = 0;
+
+#ifdef MM_ARENAS
+	/* The main arena's lock guards the options. */
+	ms = &arenas[0];
+#endif
+	LOCK();
+	switch (option) {
+	case MM_OPT_TRIM_THRESHOLD:
+		trim_threshold = value;
+		break;
+	case MM_OPT_MMAP_THRESHOLD:
+		mmap_threshold = MAX(value, MMAP_MIN);
+		break;
+	case MM_OPT_CHECK_BUDGET:
+		check_budget = value;
+		break;
+	case MM_OPT_SEGLST_NUM:
+		if (value < 2 || value > SEGLST_NUM_MAX)
+			err = -1;
+		else
+			opt_seglst_num = (int)value;
+		break;
+	case MM_OPT_LOW_BOUND:
+		if (value < 2 * DSIZE || value > TREE_MIN ||
+		    (value & (value - 1)) != 0)
+			err = -1;
+		else
+			opt_low_bound = value;
+		break;
+	case MM_OPT_CHUNKSIZE:
+		if (value == 0 || value > MAX_HEAP)
+			err = -1;
+		else
+			opt_chunk_size = ALIGN_UP(value);
+		break;
+	case MM_OPT_POLICY:
+		if (value >= MM_POLICIES)
+			err = -1;
+		else
+			opt_policy = (int)value;
+		break;
+	case MM_OPT_LIFETIME:
+		if (value > 1)
+			err = -1;
+		else
+			predict_lifetime = value;
+		break;
+	default:
+		err = -1;
+	}
+	UNLOCK();
+	return (err);
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Consolidate the fast bins, then return the free space at the end of
+ *   the heap to memlib, keeping at least "pad" bytes of it.  Returns the
+ *   number of bytes released.
+ */
+size_t
+mm_trim(size_t pad)
+{
+	size_t released = 0;
+	int i;
+
+	for (i = 0; i < NARENAS; i++) {
+#ifdef MM_ARENAS
+		ms = &arenas[i];
+#endif
+		LOCK();
+		if (ms->heap_listp != NULL) {
+#ifdef MM_ARENAS
+			remote_drain();
+#endif
+			consolidate();
+			released += do_trim(pad);
+		}
+		UNLOCK();
+	}
+	return (released);
+}
+
+/*
+ * Requires:
+ *   "stats" points to a struct mm_stats.
+ *
+ * Effects:
+ *   Fill in "stats" with a snapshot of the heap and the event counters.
+ *   The snapshot walks the heap once, so it takes time proportional to
+ *   the number of blocks.  Blocks held in thread caches or remote free
+ *   queues count as live.
+ */
+void
+mm_stats(struct mm_stats *stats)
+{
+	struct slab *sp;
+	char *bp, *p;
+	size_t size;
+	int a, i;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->heap_size = mem_heapsize();
+	stats->mapped_size = mem_mapsize();
+	stats->nclasses = seglst_lists;
+	for (i = 0; i < seglst_lists; i++)
+		stats->class_size[i] = class_size(i);
+	for (a = 0; a < NARENAS; a++) {
+#ifdef MM_ARENAS
+		ms = &arenas[a];
+#endif
+		LOCK();
+		if (ms->heap_listp == NULL) {
+			UNLOCK();
+			continue;
+		}
+#ifdef MM_ARENAS
+		/* Count the heap of an arena as heap, not as its region. */
+		if (ms->lo != NULL) {
+			stats->heap_size += ms->brk - ms->lo;
+			stats->mapped_size -= ARENA_HEAP;
+		}
+#endif
+#ifdef MM_STATS
+		stats->splits += ms->stat_counts.splits;
+		stats->coalesces += ms->stat_counts.coalesces;
+		stats->extends += ms->stat_counts.extends;
+		stats->realloc_inplace += ms->stat_counts.realloc_inplace;
+		stats->realloc_copy += ms->stat_counts.realloc_copy;
+		for (i = 0; i < MM_STATS_SEARCH; i++)
+			stats->search_hist[i] += ms->stat_counts.search_hist[i];
+#endif
+		for (bp = NEXT_BLKP(ms->heap_listp);
+		    (size = GET_SIZE(HDRP(bp))) > 0; bp = NEXT_BLKP(bp)) {
+			if (bp == ms->top)
+				stats->top_bytes += size;
+			else if (!GET_ALLOC(HDRP(bp))) {
+				i = get_list_index(size);
+				stats->class_count[i]++;
+				stats->class_bytes[i] += size;
+				stats->free_bytes += size;
+			} else if (is_slab(bp)) {
+				sp = (struct slab *)bp;
+				stats->live_bytes += (size_t)(sp->nobjs -
+				    sp->nfree) * sp->obj_size;
+				/* The blocks of a nursery chunk vary in size. */
+				for (p = NURSERY_FIRST(sp); sp->obj_size == 0 &&
+				    HDRP(p) < sp->objs + sp->used;
+				    p += GET_SIZE(HDRP(p)))
+					if (GET_ALLOC(HDRP(p)))
+						stats->live_bytes +=
+						    GET_SIZE(HDRP(p)) - WSIZE;
+			} else
+				stats->live_bytes += size - WSIZE;
+		}
+		/* Blocks in fast bins are marked allocated but are free. */
+		for (i = 0; i < FAST_BINS; i++) {
+			for (bp = ms->fast_bins[i]; bp != NULL;
+			    bp = *(void **)bp) {
+				stats->fast_bytes += GET_SIZE(HDRP(bp));
+				stats->live_bytes -= GET_SIZE(HDRP(bp)) - WSIZE;
+			}
+		}
+		UNLOCK();
+	}
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Create an empty arena.  Returns NULL if memory cannot be obtained.
+ *   An arena may be used by one thread at a time.
+ */
+struct mm_arena *
+mm_arena_create(void)
+{
+	struct mm_arena *arena;
+
+	if ((arena = mm_malloc(sizeof(struct mm_arena))) == NULL)
+		return (NULL);
+	arena->first = arena->cur = NULL;
+	arena->next = arena->end = NULL;
+	return (arena);
+}
+
+/*
+ * Requires:
+ *   "arena" was returned by mm_arena_create() and not destroyed.
+ *
+ * Effects:
+ *   Allocate "size" bytes from "arena" by bumping a pointer.  Returns NULL
+ *   if "size" is zero or memory cannot be obtained.  The object is freed
+ *   only by resetting or destroying the arena; it must not be passed to
+ *   mm_free() or mm_realloc().
+ */
+void *
+mm_arena_malloc(struct mm_arena *arena, size_t size)
+{
+	char *p;
+
+	if (size == 0 || size > MAX_HEAP)
+		return (NULL);
+	size = ALIGN_UP(size);
+	p = arena->next;
+	if ((size_t)(arena->end - p) < size)
+		return (arena_grow(arena, size));
+	arena->next = p + size;
+	return (p);
+}
+
+/*
+ * Requires:
+ *   "arena" was returned by mm_arena_create() and not destroyed.
+ *
+ * Effects:
+ *   Free every object allocated from "arena" in constant time.  The
+ *   arena keeps its chunks and allocates from them again.
+ */
+void
+mm_arena_reset(struct mm_arena *arena)
+{
+
+	arena->cur = arena->first;
+	if (arena->cur != NULL) {
+		arena->next = arena->cur->data;
+		arena->end = arena->cur->end;
+	} else
+		arena->next = arena->end = NULL;
+}
+
+/*
+ * Requires:
+ *   "arena" was returned by mm_arena_create() and not destroyed.
+ *
+ * Effects:
+ *   Free every object allocated from "arena", its chunks, and the arena.
+ */
+void
+mm_arena_destroy(struct mm_arena *arena)
+{
+	struct arena_chunk *chunk, *next;
+
+	for (chunk = arena->first; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		mm_free(chunk);
+	}
+	mm_free(arena);
+}
+
+/*
+ * Requires:
+ *   The heap "ms" is empty.  In thread-safe mode, the caller holds its lock.
+ *
+ * Effects:
+ *   Create the initial empty heap: the heads of the segregated lists, the
+ *   prologue and the epilogue.  Returns 0 on success and -1 if memory
+ *   cannot be obtained.
+ */
+static int
+heap_setup(void)
+{
+	char *p;
+	/* The prologue's payload, and so every payload, is aligned. */
+	size_t lead = ALIGN_UP(seglst_lists * sizeof(void *) + 2 * WSIZE);
+	int i;
+
+	ms->zero_lo = heap_end();
+	if ((p = heap_sbrk(lead + PROLOGUE_SIZE)) == (void *)-1)
+		return (-1);
+	ms->seg_lst = (void **)p;
+	p += lead - 2 * WSIZE;
+	for (i = 0; i < seglst_lists; i ++) {
+		ms->seg_lst[i] = NULL;
+	}
+	memset(ms->seg_map, 0, sizeof(ms->seg_map));
+	memset(ms->slab_lst, 0, sizeof(ms->slab_lst));
+	memset(ms->side, 0, sizeof(ms->side));
+	memset(ms->rover, 0, sizeof(ms->rover));
+	ms->top = NULL;
+	memset(ms->fast_bins, 0, sizeof(ms->fast_bins));
+	ms->fast_count = 0;
+	ms->listed_count = 0;
+	ms->check_cursor = NULL;
+	ms->check_lst = 0;
+	ms->check_ops = 0;
+	ms->compact_cursor = NULL;
+	ms->free_handles = NULL;
+	ms->nursery = NULL;
+	ms->nursery_spare = NULL;
+	ms->nursery_spares = 0;
+	ms->life_clock = 0;
+	ms->life_count = 0;
+	memset(ms->life_score, 0, sizeof(ms->life_score));
+	memset(ms->life_samples, 0, sizeof(ms->life_samples));
+#ifdef MM_STATS
+	memset(&ms->stat_counts, 0, sizeof(ms->stat_counts));
+#endif
+	/* Alignment padding */
+	PUT(p, 0);                           
+	/* Prologue header */ 
+	PUT(p + (1 * WSIZE), PACK(PROLOGUE_SIZE, PREV_ALLOC | ALLOC)); 
+	ms->heap_listp = p + 2 * WSIZE; 
+	/* Prologue footer */ 
+	PUT(FTRP(ms->heap_listp), PACK(PROLOGUE_SIZE, PREV_ALLOC | ALLOC));
+	/* Epilogue header */ 
+	PUT(HDRP(NEXT_BLKP(ms->heap_listp)), PACK(0, PREV_ALLOC | ALLOC));      
+	/* The zero tail starts after the list heads and the prologue. */
+	ms->zero_lo = MAX(ms->zero_lo, HDRP(NEXT_BLKP(ms->heap_listp)));
+
+	return (0);
+}
+
+/* 
+ * Requires:
+ *   "size" is not zero.  In thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Allocate a block with at least "size" bytes of payload from the shared
+ *   segregated lists, extending the heap if no fit is found.  Returns the
+ *   address of this block if the allocation was successful and NULL
+ *   otherwise.
+ */
+static void *
+do_malloc(size_t size) 
+{
+
+	return (do_malloc_hint(size, MM_HINT_NONE));
+}
+
+/* 
+ * Requires:
+ *   "size" is not zero, and "hint" is one of the MM_HINT_ values.  In
+ *   thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Allocate a block like do_malloc(), from the nursery if "hint" or, for
+ *   MM_HINT_NONE, the lifetime predictor says the block dies young.
+ */
+static void *
+do_malloc_hint(size_t size, int hint) 
+{
+	if (debug_flag) {
+		printf("********========+++++++++##############\n");
+		printf("MM_MALLOC: ");
+		printf("Malloc size of: %d bytes, %d words\n", (int)size, (int)size / 8); 
+	}
+	if (debug_flag) {
+		printf("mm_malloc: print list 4\n");
+		struct free_block_body *temp = ms->seg_lst[4];
+		if (temp != NULL)
+			printblock(temp);
+	}
+	void *bp;
+	size_t asize;
+
+	ms->life_clock++;
+	/* Small objects are carved from slabs. */
+	if (size <= SLAB_MAX)
+		return (slab_malloc(size));
+	/* Huge ones get a region of their own, if one can be mapped. */
+	if (size >= mmap_threshold && (bp = map_alloc(size, ALIGN_SIZE)) != NULL)
+		return (bp);
+	/* Adjust block size to include overhead and alignment reqs. */
+	asize = adjust_size(size);
+	if (asize > NURSERY_MAX)
+		return (heap_malloc(asize));
+	/* Blocks that should die young go to the nursery. */
+	bp = NULL;
+	if (hint == MM_HINT_SHORT || (hint == MM_HINT_NONE &&
+	    predict_lifetime && ms->life_score[asize / ALIGN_SIZE] > 0))
+		bp = nursery_malloc(asize);
+	if (bp == NULL)
+		bp = heap_malloc(asize);
+	if (bp != NULL && predict_lifetime)
+		life_birth(bp, asize);
+	return (bp);
+}
+
+/* 
+ * Requires:
+ *   "ptr" is the address of an allocated block of this heap, and "size"
+ *   is not zero.  In thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Allocate a block like do_malloc(), from the slab of "ptr" if both are
+ *   slab objects of one class and from a free block near "ptr" if one
+ *   fits.  Returns the address of this block if the allocation was
+ *   successful and NULL otherwise.
+ */
+static void *
+do_malloc_near(void *ptr, size_t size)
+{
+	struct slab *sp;
+	void *bp;
+	size_t asize;
+
+	if (size <= SLAB_MAX) {
+		sp = SLAB_OF(ptr);
+		if (!is_slab(ptr) || sp->obj_size != ALIGN_UP(size) ||
+		    sp->nfree == 0)
+			return (do_malloc(size));
+		ms->life_clock++;
+		return (slab_take(sp));
+	}
+	if (size >= mmap_threshold || (!is_slab(ptr) && IS_MAPPED(ptr)))
+		return (do_malloc(size));
+	/* Near blocks age and are sampled like those of do_malloc_hint(). */
+	ms->life_clock++;
+	/* A slab object's neighbors are those of its slab. */
+	asize = adjust_size(size);
+	bp = near_fit(is_slab(ptr) ? (void *)SLAB_OF(ptr) : ptr, asize);
+	bp = bp != NULL ? place(bp, asize) : heap_malloc(asize);
+	if (bp != NULL && predict_lifetime && asize <= NURSERY_MAX)
+		life_birth(bp, asize);
+	return (bp);
+}
+
+/*
+ * Requires:
+ *   "asize" is an adjusted block size.  In thread-safe mode, the caller
+ *   holds the heap lock.
+ *
+ * Effects:
+ *   Allocate a heap block of "asize" bytes from the fast bins or the
+ *   segregated lists, extending the heap if no fit is found.  Returns the
+ *   address of this block if the allocation was successful and NULL
+ *   otherwise.
+ */
+static void *
+heap_malloc(size_t asize)
+{
+	void *bp;
+
+	/* Reuse a recently freed block of exactly this size. */
+	if (asize <= FAST_MAX &&
+	    (bp = ms->fast_bins[asize / ALIGN_SIZE]) != NULL) {
+		ms->fast_bins[asize / ALIGN_SIZE] = *(void **)bp;
+		ms->fast_count--;
+		return (bp);
+	}
+	/* Search the free list for a fit. */
+	if (check_block_flag) {
+		printf("mm_malloc: start check_block_flag\n");
+		checkheap(false);
+		checklist();
+		printf("mm_malloc: end check_block_flag\n");
+	}
+	
+	if ((bp = find_fit(asize)) != NULL ||
+	    (ms->fast_count > 0 &&
+	    (consolidate(), bp = find_fit(asize)) != NULL)) {
+		if (debug_flag)
+			printf("mm_malloc: place the block into a seglst\n");
+		bp = place(bp, asize);
+		return (bp);
+	}
+
+	/* No fit found, even among the fast bins. Grow the top chunk and
+	 * place the block. */
+	if (debug_flag)
+		printf("mm_malloc: No fit found. Get more memory and place the block.\n");
+	if ((bp = grow_top(asize)) == NULL)
+		return (NULL);
+	bp = place(bp, asize);
+	if (debug_flag) {
+		printf("mm_malloc: after malloc print list 4\n");
+		struct free_block_body *temp = ms->seg_lst[4];
+		if (temp != NULL)
+			printblock(temp);
+	}
+	return (bp);
+} 
+
+/* 
+ * Requires:
+ *   "bp" is the address of an allocated block.  In thread-safe mode, the
+ *   caller holds the heap lock.
+ *
+ * Effects:
+ *   Free a block and return it to a fast bin or the shared segregated
+ *   lists.
+ */
+static void
+do_free(void *bp)
+{
+	size_t size;
+
+	if (predict_lifetime)
+		life_death(bp);
+	if (is_slab(bp)) {
+		slab_free(bp);
+		return;
+	}
+	if (IS_MAPPED(bp)) {
+		map_free(bp);
+		return;
+	}
+	/* Defer coalescing small blocks by keeping them in a fast bin. */
+	size = GET_SIZE(HDRP(bp));
+	if (size <= FAST_MAX) {
+		PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)) | ALLOC));
+		*(void **)bp = ms->fast_bins[size / ALIGN_SIZE];
+		ms->fast_bins[size / ALIGN_SIZE] = bp;
+		ms->fast_count++;
+		return;
+	}
+	free_block(bp);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of an allocated heap block that is not in a fast
+ *   bin.  In thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Free the block, coalesce it with its free neighbors and return it to
+ *   the segregated lists, trimming the heap if the result ends it.
+ */
+static void
+free_block(void *bp)
+{
+	size_t size = GET_SIZE(HDRP(bp));
+
+	if (debug_flag) {
+		printf("########***********=======+++++++=======\n");
+		printf("MM_FREE: ");
+		printf("mm_free: Freeing size %d\n", (int)size);
+	}
+	PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));
+	PUT(FTRP(bp), GET(HDRP(bp)));
+	CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+	if (debug_flag) {
+		printf("mm_free: middle: print list 5\n");
+		printlist(5);
+	}
+	insert_block(bp, size);
+
+	bp = coalesce(bp);
+	/* Give a large enough top chunk back to memlib. */
+	if (bp == ms->top && GET_SIZE(HDRP(bp)) >= trim_threshold)
+		do_trim(TRIM_PAD);
+}
+
+/*
+ * Requires:
+ *   In thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Empty every fast bin, freeing and coalescing its blocks into the
+ *   segregated lists.
+ */
+static void
+consolidate(void)
+{
+	void *bp;
+	int i;
+
+	for (i = 0; i < FAST_BINS; i++) {
+		while ((bp = ms->fast_bins[i]) != NULL) {
+			ms->fast_bins[i] = *(void **)bp;
+			free_block(bp);
+		}
+	}
+	ms->fast_count = 0;
+}
+
+/*
+ * Requires:
+ *   "ptr" is the address of an allocated block and "size" is not zero.  In
+ *   thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Reallocates the block "ptr" to a block with at least "size" bytes of
+ *   payload, growing or shrinking it in place when possible.  Returns the
+ *   address of the resulting block if the reallocation was successful and
+ *   NULL otherwise, in which case "ptr" is left untouched.
+ */
+static void *
+do_realloc(void *ptr, size_t size)
+{
+	if (debug_flag) {
+		printf("*******+++++++============********\n");
+		printf("MM_REALLOC: ");
+		printf("mm_realloc: realloc to size of: %d\n", (int)size);
+	}
+	size_t oldsize;
+	void *newptr;
+
+	/* A slab object keeps its slot while the new size still fits. */
+	if (is_slab(ptr)) {
+		oldsize = usable_size(ptr);
+		if (size <= oldsize)
+			return (ptr);
+		if ((newptr = do_malloc(size)) == NULL)
+			return (NULL);
+		memcpy(newptr, ptr, oldsize);
+		do_free(ptr);
+		return (newptr);
+	}
+	/*
+	 * A mapped block stays in its region while the new size fits and is
+	 * still above the threshold.  Otherwise it moves, and if it grows,
+	 * it gets the same slack as a heap block that grew before.
+	 */
+	if (IS_MAPPED(ptr)) {
+		oldsize = map_usable_size(ptr);
+		if (size <= oldsize && size >= mmap_threshold)
+			return (ptr);
+		newptr = do_malloc(size > oldsize ?
+		    size + REALLOC_SLACK(size) : size);
+		if (newptr == NULL)
+			return (NULL);
+		memcpy(newptr, ptr, MIN(size, oldsize));
+		map_free(ptr);
+		return (newptr);
+	}
+	/* the block size "size" bytes of payload need, as for malloc */
+	int realloc_asize = (int)adjust_size(size);
+	/* size of previously allocated block */
+	oldsize = GET_SIZE(HDRP(ptr));
+	int size_diff = (int)(oldsize - realloc_asize);
+	/* the size to grow to, including slack if the block grew before */
+	int slack_asize = realloc_asize;
+	if (size_diff < 0 && GET_REALLOCED(HDRP(ptr)))
+		slack_asize = MAX(realloc_asize,
+		    (int)(oldsize + REALLOC_SLACK(oldsize)));
+
+	if (debug_flag) {
+		printf("mm_realloc: realloc_asize: %d\n", realloc_asize);
+		printf("mm_realloc: oldsize: %d\n", (int)oldsize);
+		printf("mm_realloc: realloc_asize: %d\n", realloc_asize);
+		printf("mm_realloc: size_diff: %d\n", size_diff);
+	}
+
+	if (realloc_asize == (int)oldsize) {
+		if (debug_flag) { 
+			printf("mm_realloc: realloc_asize == oldsize\n");
+		}
+		return (ptr);
+	}
+	/* new size required is less than previous allocated size */
+	else if (size_diff > 0) {
+		/* new size required is less than previous allocated size, 
+	 	 * and size in difference can form a new block */
+		if (size_diff >= (int)(2 * DSIZE) &&
+		    (!GET_REALLOCED(HDRP(ptr)) || size_diff > realloc_asize)) {
+			if (debug_flag) { 
+				printf("mm_realloc: size_diff >= (int)(2 * DSIZE)\n");
+			}
+			void *rest;
+
+			PUT(HDRP(ptr), PACK(realloc_asize, GET_PREV_ALLOC(HDRP(ptr)) |
+			    GET_REALLOCED(HDRP(ptr)) | ALLOC));
+
+			rest = NEXT_BLKP(ptr);
+
+			PUT(HDRP(rest), PACK(size_diff, PREV_ALLOC));
+			PUT(FTRP(rest), PACK(size_diff, PREV_ALLOC));
+			CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(rest)));
+
+			insert_block(rest, size_diff);
+
+			coalesce(rest);
+
+			return (ptr);
+		} 
+		/* new size required is less than previous allocated size, 
+	 	 * but size in difference cannot form a new block */
+		else {
+			if (debug_flag) { 
+				printf("mm_realloc: size_diff < (int)(2 * DSIZE)\n");
 			} 
 			return (ptr);
 		}
-	} 
-	/* new size required is greater than the previous allocated size */
-	else if (size_diff < 0){
+	} 
+	/* new size required is greater than the previous allocated size */
+	else if (size_diff < 0){
+
+		size_t next_block_size = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
+		/* make size_diff multiple of 8 */ 
+		if (debug_flag) { 
+			printf("mm_realloc: next_block_size: %d\n", (int)next_block_size);
+			printf("mm_realloc: next_block_allocated: %d\n", (int)GET_ALLOC(HDRP(NEXT_BLKP(ptr))));
+			printf("mm_realloc: current_block_size: %d\n", (int)GET_SIZE(HDRP(ptr)));
+		}
+		/* block next to current block is free */
+		if (!GET_ALLOC(HDRP(NEXT_BLKP(ptr)))) {
+			/* take the slack too if the next block has room */
+			if (oldsize + next_block_size >= (size_t)slack_asize) {
+				realloc_asize = slack_asize;
+				size_diff = (int)(oldsize - realloc_asize);
+			}
+			/* next free block has enough extra space to form a new free block */
+			if ((int)next_block_size >= (int)(abs(size_diff) + 2 * DSIZE)) {
+				if (debug_flag) { 
+					printf("mm_realloc: (int)next_block_size >= (int)(abs(size_diff) + 2 * DSIZE)\n");
+				}
+				void *rest;
+
+				STAT_INC(splits);
+				delete_block(NEXT_BLKP(ptr));
+				CURSOR_ABSORB(NEXT_BLKP(ptr), ptr);
+
+				PUT(HDRP(ptr), PACK(realloc_asize,
+				    GET_PREV_ALLOC(HDRP(ptr)) | REALLOCED | ALLOC));
+
+				rest = NEXT_BLKP(ptr);
+
+				int new_next_block_size = (int)next_block_size - abs(size_diff);  
+
+				PUT(HDRP(rest), PACK(new_next_block_size, PREV_ALLOC)); 
+				PUT(FTRP(rest), PACK(new_next_block_size, PREV_ALLOC));  
+				insert_block(rest, new_next_block_size);
+				mark_used(ptr);
+
+				coalesce(rest);
+
+				return (ptr);
+			} 
+			/* next free block doesnot have enough extra space to form a new free block */
+			else if ((int)next_block_size >= abs(size_diff)) {
+				if (debug_flag) { 
+					printf("mm_realloc: (int)next_block_size >= abs(size_diff)\n");
+				}
+				delete_block(NEXT_BLKP(ptr));
+				CURSOR_ABSORB(NEXT_BLKP(ptr), ptr);
+
+				PUT(HDRP(ptr), PACK((int)(oldsize + next_block_size),
+				    GET_PREV_ALLOC(HDRP(ptr)) | REALLOCED | ALLOC));
+				SET_PREV_ALLOC(HDRP(NEXT_BLKP(ptr)));
+				mark_used(ptr);
+
+				return (ptr);
+			}
+		}
+		/*
+		 * Otherwise the block can still grow in place by taking in a
+		 * free previous block, moving the payload down, or by extending
+		 * the heap when it is the last block.  The next block, if free,
+		 * is taken in as well.  Growth at the heap top needs no copy,
+		 * so it takes no slack either.
+		 */
+		void *next = NEXT_BLKP(ptr);
+		size_t avail = oldsize;
+		if (!GET_ALLOC(HDRP(next))) {
+			avail += next_block_size;
+			next = NEXT_BLKP(next);
+		}
+		if (!GET_PREV_ALLOC(HDRP(ptr)) && avail +
+		    GET_SIZE(HDRP(PREV_BLKP(ptr))) >= (size_t)realloc_asize) {
+			if (debug_flag) { 
+				printf("mm_realloc: grow into previous block\n");
+			}
+			return (realloc_backward(ptr, avail, slack_asize,
+			    realloc_asize));
+		}
+		if (GET_SIZE(HDRP(next)) == 0) {
+			if (debug_flag) { 
+				printf("mm_realloc: next_block is end of heap\n");
+			}
+			if (heap_sbrk(realloc_asize - avail) != (void *)-1) {
+				STAT_INC(extends);
+				if (avail != oldsize)
+					delete_block(NEXT_BLKP(ptr));
+				CURSOR_ABSORB(NEXT_BLKP(ptr), ptr);
+				CURSOR_ABSORB(next, ptr);
+				PUT(HDRP(ptr), PACK(realloc_asize,
+				    GET_PREV_ALLOC(HDRP(ptr)) | REALLOCED | ALLOC));
+				/* New epilogue header */
+				PUT(HDRP(NEXT_BLKP(ptr)), PACK(0, PREV_ALLOC | ALLOC));
+				mark_used(ptr);
+				return (ptr);
+			}
+		}
+	}  
+	if (debug_flag) { 
+		printf("mm_realloc: mm_malloc, mm_free\n");
+	}
+	newptr = do_malloc(slack_asize - WSIZE);
+	/* If realloc() fails the original block is left untouched  */
+	if (newptr == NULL)
+		return (NULL);
+	if (!is_slab(newptr) && !IS_MAPPED(newptr))
+		PUT(HDRP(newptr), GET(HDRP(newptr)) | REALLOCED);
+	if (debug_flag) {
+		printf("mm_realloc: before memcpy: print list 5\n");
+		printlist(5);
+	}
+	/* copy the old payload, which ends where the block does */
+	oldsize -= WSIZE;
+	if (size < oldsize)
+		oldsize = size;
+	memcpy(newptr, ptr, oldsize);
+	if (debug_flag) {
+		printf("mm_realloc: after memcpy: print list 5\n");
+		printlist(5);
+	}
+	/* Free the old block. */
+	do_free(ptr);
+	return (newptr);
+}
+
+/*
+ * Requires:
+ *   "ptr" is the address of an allocated block whose previous block is
+ *   free.  "avail" is the size of "ptr" plus that of its next block if
+ *   that is free, and together with the previous block it is at least
+ *   "asize" bytes.  "slack_asize" is at least "asize".
+ *
+ * Effects:
+ *   Grow the block "ptr" backward into its free previous block, and into
+ *   its free next block if "avail" includes it.  The payload is moved to
+ *   the start of the previous block.  The grown block has "slack_asize"
+ *   bytes if there is room for them and at least "asize" otherwise; space
+ *   beyond that is split off into a free block if it is large enough.
+ *   Returns the new address of the block.
+ */
+static void *
+realloc_backward(void *ptr, size_t avail, size_t slack_asize, size_t asize)
+{
+	void *prev = PREV_BLKP(ptr);
+	size_t oldsize = GET_SIZE(HDRP(ptr));
+	size_t total = GET_SIZE(HDRP(prev)) + avail;
+	void *rest;
+
+	delete_block(prev);
+	if (avail != oldsize) {
+		delete_block(NEXT_BLKP(ptr));
+		CURSOR_ABSORB(NEXT_BLKP(ptr), prev);
+		/* The remainder split off below may take in its tags. */
+		zero_absorbed(NEXT_BLKP(ptr), avail - oldsize);
+	}
+	CURSOR_ABSORB(ptr, prev);
+	if (predict_lifetime)
+		life_forget(ptr);
+	memmove(prev, ptr, oldsize - WSIZE);
+	if (total >= slack_asize)
+		asize = slack_asize;
+	if (total - asize >= 2 * DSIZE) {
+		STAT_INC(splits);
+		PUT(HDRP(prev), PACK(asize,
+		    GET_PREV_ALLOC(HDRP(prev)) | REALLOCED | ALLOC));
+		rest = NEXT_BLKP(prev);
+		PUT(HDRP(rest), PACK(total - asize, PREV_ALLOC));
+		PUT(FTRP(rest), GET(HDRP(rest)));
+		CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(rest)));
+		insert_block(rest, (int)(total - asize));
+	} else {
+		PUT(HDRP(prev), PACK(total,
+		    GET_PREV_ALLOC(HDRP(prev)) | REALLOCED | ALLOC));
+		SET_PREV_ALLOC(HDRP(NEXT_BLKP(prev)));
+	}
+	mark_used(prev);
+	return (prev);
+}
+
+/*
+ * Requires:
+ *   In thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Shrink the heap so that the top chunk, if any, keeps "pad" bytes
+ *   rounded up to a valid block size, or disappears when "pad" is zero.
+ *   The epilogue header moves down to the new end of the heap.  Returns
+ *   the number of bytes released.
+ */
+static size_t
+do_trim(size_t pad)
+{
+	char *bp = ms->top;
+	size_t size, keep;
+
+	if (bp == NULL)
+		return (0);
+	size = GET_SIZE(HDRP(bp));
+	keep = 0;
+	if (pad > 0)
+		keep = MAX(ALIGN_UP(pad), 2 * DSIZE);
+	if (keep >= size)
+		return (0);
+	if (heap_sbrk(-(intptr_t)(size - keep)) == (void *)-1)
+		return (0);
+	if (keep > 0) {
+		PUT(HDRP(bp), PACK(keep, GET_PREV_ALLOC(HDRP(bp))));
+		PUT(FTRP(bp), GET(HDRP(bp)));
+	} else
+		ms->top = NULL;
+	if (ms->check_cursor >= bp + keep)
+		ms->check_cursor = NULL;
+	if (ms->compact_cursor >= bp + keep)
+		ms->compact_cursor = NULL;
+	/* New epilogue header */
+	PUT(HDRP(bp + keep), PACK(0, (keep > 0 ? 0 : PREV_ALLOC) | ALLOC));
+	if (debug_flag)
+		printf("do_trim: released %zu bytes\n", size - keep);
+	return (size - keep);
+}
+
+/*
+ * Requires:
+ *   "size" is not zero.
+ *
+ * Effects:
+ *   Return the block size, including overhead and alignment padding, that
+ *   an allocation of "size" bytes of payload is given.
+ */
+static size_t
+adjust_size(size_t size)
+{
+	/* an allocated block has a header but no footer */
+	return (MAX(ALIGN_UP(size + WSIZE), 2 * DSIZE));
+}
+
+/* 
+ * Requires: 
+ *	bp is not null
+ * Effects: 
+ * 	Insert block bp to a specific seglist.
+ * 	Insertaion order will base on block size
+ */
+static void
+insert_block(void *bp, int size)
+{
+	if (debug_flag) {
+		printf("*******+++++++============********\n");
+		printf("INSERT_BLOCK: ");
+		printf("insert_block: block size %d bytes, %d words\n", size, size / 8);
+		printf("(int)GET_SIZE(HDRP(bp)): %d bytes\n", (int)GET_SIZE(HDRP(bp)));
+	}
+	assert(bp != NULL);
+	assert(size >= 0);
+	assert(size == (int)GET_SIZE(HDRP(bp)));
+
+	int lst_indx;
+
+	/* The block that ends the heap becomes the top chunk instead. */
+	if (GET_SIZE(HDRP((char *)bp + size)) == 0) {
+		ms->top = bp;
+		return;
+	}
+	lst_indx = get_list_index(size);
+	if (debug_flag) {
+		printf("insert_block: lst_indx: %d\n", lst_indx);
+	}
+	SET_LISTED(bp);
+	ms->listed_count++;
+	/* large classes keep their blocks in a tree */
+	if (lst_indx >= tree_lst) {
+		tree_insert(lst_indx, bp);
+		return;
+	}
+	if (debug_flag) {
+		printf("insert_block: before insert_block: print list 4\n");
+		printlist(4);
+	}
+	policy->link(lst_indx, bp, size);
+	if (debug_flag) {
+		printf("insert_block: after insert_block: print list 4\n");
+		printlist(4);
+	}
+}
+
+/*
+ * Requires:
+ *	"bp" is a free block of "size" bytes that belongs to list "lst_indx".
+ * Effects:
+ *	Push "bp" on the head of the list, Last In First Out.
+ */
+static void
+link_head(int lst_indx, void *bp, int size)
+{
+	struct free_block_body *new_block, *start_block;
+
+	start_block = ms->seg_lst[lst_indx];
+	new_block = bp;
+	/* seglist been insert into is empty */
+	if (start_block == NULL) {
+		SET_PREV_FREE(new_block, NULL);
+		SET_NEXT_FREE(new_block, NULL);
+		ms->seg_lst[lst_indx] = new_block;
+		ms->seg_map[lst_indx / 64] |= (uint64_t)1 << (lst_indx % 64);
+	}
+	/* seglist been insert into is not empty */
+	else {
+		SET_PREV_FREE(new_block, NULL);
+		SET_NEXT_FREE(new_block, start_block);
+		SET_PREV_FREE(start_block, new_block);
+		ms->seg_lst[lst_indx] = new_block;
+	}
+	if (IS_SIDE_LIST(lst_indx))
+		side_insert(lst_indx, bp, size);
+}
+
+/*
+ * Requires:
+ *	"bp" is a free block that belongs to list "lst_indx", which has no
+ *	side index.
+ * Effects:
+ *	Link "bp" into the list in address order.  This takes time
+ *	proportional to the blocks below "bp" on the list.
+ */
+static void
+link_ordered(int lst_indx, void *bp, int size)
+{
+	struct free_block_body *prev = NULL, *next = ms->seg_lst[lst_indx];
+
+	(void)size;
+	while (next != NULL && (char *)next < (char *)bp) {
+		prev = next;
+		next = NEXT_FREE(next);
+	}
+	SET_PREV_FREE(bp, prev);
+	SET_NEXT_FREE(bp, next);
+	if (next != NULL)
+		SET_PREV_FREE(next, bp);
+	if (prev != NULL)
+		SET_NEXT_FREE(prev, bp);
+	else {
+		ms->seg_lst[lst_indx] = bp;
+		ms->seg_map[lst_indx / 64] |= (uint64_t)1 << (lst_indx % 64);
+	}
+}
+
+/* 
+ * Requires:
+ *	nothing
+ * Effects:
+ *	return the seglist index based on size of insert block
+ */
+static int
+get_list_index(int size)
+{
+	assert(size >= 0);
+	int fl_bit, fl, sl;
+
+	/* small blocks have one list per exact size */
+	if (size < (int)low_bound)
+		return (size / (int)ALIGN_SIZE);
+	/* first level: the power of two range, found with a bit scan */
+	fl_bit = 31 - __builtin_clz((unsigned)size);
+	fl = fl_bit - __builtin_ctzl(low_bound) + 1;
+	if (fl >= seglst_num)
+		return (seglst_lists - 1);
+	/* second level: the bits just below the leading one */
+	sl = (size >> (fl_bit - SEGLST_SUB_BITS)) & (SEGLST_SUB - 1);
+
+	return (seglst_small + (fl - 1) * SEGLST_SUB + sl);
+}
+
+/*
+ * Requires:
+ *	0 <= lst_indx < seglst_lists
+ * Effects:
+ *	return the smallest block size that belongs to seglist lst_indx
+ */
+static size_t
+class_size(int lst_indx)
+{
+	size_t base;
+
+	if (lst_indx < seglst_small)
+		return ((size_t)lst_indx * ALIGN_SIZE);
+	lst_indx -= seglst_small;
+	base = low_bound << (lst_indx / SEGLST_SUB);
+	return (base + (lst_indx % SEGLST_SUB) * (base >> SEGLST_SUB_BITS));
+}
+
+/*
+ * Requires:
+ *	0 <= lst_indx
+ * Effects:
+ *	return the index of the first non-empty seglist at or after lst_indx,
+ *	or -1 if every such seglist is empty
+ */
+static int
+find_nonempty_list(int lst_indx)
+{
+	int word = lst_indx / 64;
+	uint64_t bits;
+
+	if (lst_indx >= seglst_lists)
+		return (-1);
+	bits = ms->seg_map[word] & (~(uint64_t)0 << (lst_indx % 64));
+	while (bits == 0) {
+		if (++word >= SEGLST_MAP_WORDS)
+			return (-1);
+		bits = ms->seg_map[word];
+	}
+	return (word * 64 + __builtin_ctzll(bits));
+}
+
+/*
+ * Requires:
+ *	Nothing
+ * Effects:
+ * 	remove free block bp from the specific seglist
+ */
+static void
+delete_block(void *bp) {
+
+	if (debug_flag) {
+		printf("*******+++++++============********\n");
+		printf("DELETE_BLOCK: \n");
+	}
+	assert(bp != NULL);
+
+	struct free_block_body *curr_block;
+	struct free_block_body *smaller_block;
+	struct free_block_body *bigger_block; 
+	int lst_indx;
+	size_t block_size;
+
+	if (bp == ms->top) {
+		ms->top = NULL;
+		return;
+	}
+	/* get size of the block */
+	block_size = GET_SIZE(HDRP(bp));
+	if (debug_flag) { 
+		printf("delete_block: size of the block to delete: %d\n", (int)block_size);
+	}
+	/* get seglist index */
+	lst_indx = get_list_index(block_size);
+	if (debug_flag) { 
+		printf("delete_block: index of seglist: %d\n", lst_indx);
+	}
+	CLEAR_LISTED(bp);
+	ms->listed_count--;
+	if (lst_indx >= tree_lst) {
+		tree_delete(lst_indx, bp);
+		return;
+	}
+	curr_block = (struct free_block_body *)bp;
+	bigger_block = PREV_FREE(curr_block);
+	smaller_block = NEXT_FREE(curr_block); 
+	/* next fit resumes after a block it took */
+	if (ms->rover[lst_indx] == curr_block)
+		ms->rover[lst_indx] = smaller_block;
+	
+	if (debug_flag) {
+		printf("delete_block: before delete: print list 5\n");
+		printlist(5);
+	}
+
+	/* block to delete has no block preceeding it */
+	if (bigger_block == NULL) { 
+		/* block to delete has no block after it */
+		if (smaller_block == NULL) {
+			ms->seg_lst[lst_indx] = NULL;
+			ms->seg_map[lst_indx / 64] &=
+			    ~((uint64_t)1 << (lst_indx % 64));
+			if (debug_flag) { 
+				printf("delete_block: no left no right\n");
+			}
+		}
+		/* block to delete has block after it */
+		else {
+			if (debug_flag) { 
+				printf("delete_block: no left has right\n");
+			}
+			SET_PREV_FREE(smaller_block, NULL);
+			ms->seg_lst[lst_indx] = smaller_block;
+		}
+	/* block to delete has block preceeding it */
+	} else { 
+		/* block to delete has no block after it */
+		if (smaller_block == NULL) {
+			if (debug_flag) { 
+				printf("delete_block: has left not right\n");
+			}
+			SET_NEXT_FREE(bigger_block, NULL);
+		}
+		/* block to delete has block after it */
+		else {
+			if (debug_flag) { 
+				printf("delete_block: has left has right\n");
+			}
+			SET_NEXT_FREE(bigger_block, smaller_block);
+			if (debug_flag) { 
+				printf("delete_block: inside_if_2_2_1\n");
+			}
+			SET_PREV_FREE(smaller_block, bigger_block);
+			if (debug_flag) { 
+				printf("delete_block: inside_if_2_2_2\n");
+			}
+		}
+	}
+	if (IS_SIDE_LIST(lst_indx))
+		side_delete(lst_indx, bp);
+	if (debug_flag) {
+		printf("delete_block: after delete: print list 5\n");
+		printlist(5);
+	}
+}
+
+/*
+ * The following routines are internal helper routines.
+ */
+/* 
+ * Requires:
+ *   "bp" is the address of a free block that is at least "asize" bytes.
+ *
+ * Effects:
+ *   Place a block of "asize" bytes at the start of the free block "bp" and
+ *   split that block if the remainder would be at least the minimum block
+ *   size. 
+ */
+static void *
+place(void *bp, size_t asize)
+{
+	if (debug_flag) {
+		printf("*******+++++++============********\n");
+		printf("PLACE: \n");
+	}
+	size_t csize = GET_SIZE(HDRP(bp));   
+	if (debug_flag) { 
+		printf("place: free block size: %d\n", (int)csize);
+		printblock(bp); 
+		printf("place: block size to place: %d\n", (int)asize);
+	}
+	if (check_block_flag) {
+		checkheap(false);
+		checklist();
+	}
+	// if ((csize - asize) >= (2 * DSIZE)) { 
+	/*
+	 * a block has to contain header, footer and at least two words for 
+	 * the forward link and backward link
+	 */
+	if (debug_flag) {
+		printf("place: before place: print list 4\n");
+		printlist(4);
+		printf("place: outside_debug_flag\n");
+	}
+	if (debug_flag) {
+		printf("place: reached\n"); 
+	}
+	/* block has remainder that qualify another free block */
+	if ((csize - asize) >= (2 * DSIZE)) {  
+		void *rest;
+
+		STAT_INC(splits);
+		delete_block(bp); 
+
+		PUT(HDRP(bp), PACK(asize, GET_PREV_ALLOC(HDRP(bp)) | ALLOC));
+
+		rest = NEXT_BLKP(bp); 
+		
+		PUT(HDRP(rest), PACK(csize - asize, PREV_ALLOC));
+		PUT(FTRP(rest), PACK(csize - asize, PREV_ALLOC)); 
+
+		insert_block(rest, (int)(csize - asize)); 
+		mark_used(bp);
+
+		return (bp);
+	}
+	/* block doesnot has remainder that qualify another free block */ 
+	else {
+		if (debug_flag) {
+			printf("place_reached_ELSE: \n");
+			printf("place: csize: %d\n", (int)csize);
+		}
+		delete_block(bp);
+
+		PUT(HDRP(bp), PACK(csize, GET_PREV_ALLOC(HDRP(bp)) | ALLOC));
+		SET_PREV_ALLOC(HDRP(NEXT_BLKP(bp)));
+		mark_used(bp);
+
+		return (bp);
+	}
+	if (debug_flag) {
+		printf("place: after place: print list 4\n");
+		printlist(4);
+	}
+}
+
+/*
+ * Requires:
+ *   "asize" is a valid block size too large for the slabs.  "out" has
+ *   room for "n" pointers.  In thread-safe mode, the caller holds the
+ *   heap lock.
+ *
+ * Effects:
+ *   Allocate up to "n" blocks of "asize" bytes, storing their addresses in
+ *   "out".  The fast bin of that size is emptied first, and the rest are
+ *   carved in a row out of a single free block, found or made at the end
+ *   of the heap, whose remainder goes back to the lists.  Returns the
+ *   number of blocks allocated, which is zero if no such block could be
+ *   had.
+ */
+static size_t
+place_batch(size_t n, size_t asize, void **out)
+{
+	size_t i = 0, csize, total;
+	size_t prev_alloc;
+	char *bp;
+
+	if (asize <= FAST_MAX) {
+		while (i < n && (bp = ms->fast_bins[asize / ALIGN_SIZE]) !=
+		    NULL) {
+			ms->fast_bins[asize / ALIGN_SIZE] = *(void **)bp;
+			ms->fast_count--;
+			out[i++] = bp;
+		}
+	}
+	n = MIN(n - i, MAX_HEAP / asize);
+	if (n == 0)
+		return (i);
+	total = n * asize;
+	if ((bp = find_fit(total)) == NULL &&
+	    (ms->fast_count == 0 || (consolidate(),
+	    bp = find_fit(total)) == NULL) &&
+	    (bp = grow_top(total)) == NULL)
+		return (i);
+	STAT_INC(splits);
+	csize = GET_SIZE(HDRP(bp));
+	prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+	delete_block(bp);
+	for (; n > 0; n--, bp += asize) {
+		PUT(HDRP(bp), PACK(asize, prev_alloc | ALLOC));
+		prev_alloc = PREV_ALLOC;
+		out[i++] = bp;
+	}
+	/* Split off the remainder, or let the last block take it in. */
+	csize -= total;
+	if (csize >= 2 * DSIZE) {
+		PUT(HDRP(bp), PACK(csize, PREV_ALLOC));
+		PUT(FTRP(bp), GET(HDRP(bp)));
+		insert_block(bp, (int)csize);
+	} else {
+		PUT(HDRP(out[i - 1]), GET(HDRP(out[i - 1])) + csize);
+		SET_PREV_ALLOC(HDRP(bp + csize));
+	}
+	mark_used(out[i - 1]);
+	return (i);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a block just allocated or grown.
+ *
+ * Effects:
+ *   Move the zero tail of the heap up past the payload of "bp", which the
+ *   caller may now write.
+ */
+static void
+mark_used(void *bp)
+{
+	char *end = HDRP(NEXT_BLKP(bp));
+
+	if (end > ms->zero_lo)
+		ms->zero_lo = end;
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a free block of "size" bytes that is being
+ *   merged into the block before it.
+ *
+ * Effects:
+ *   Clear the footer of the block before, and the header and links of
+ *   "bp", where they lie in the zero tail of the heap, as they are inside
+ *   the merged block from now on.  The footer of "bp" is left alone.
+ */
+static void
+zero_absorbed(void *bp, size_t size)
+{
+	char *lo = MAX(HDRP(bp) - WSIZE, ms->zero_lo);
+	char *hi = (char *)bp + MIN(LINKS_SIZE, size - DSIZE);
+
+	if (hi > lo)
+		memset(lo, 0, hi - lo);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a newly freed block.
+ *
+ * Effects:
+ *   Perform boundary tag coalescing. Returns the address of the coalesced
+ *   block.
+ */
+static void *
+coalesce(void *bp) 
+{
+	if (debug_flag) {
+		printf("*******+++++++============********\n");
+		printf("COALESCE: \n");
+	}
+	size_t size = GET_SIZE(HDRP(bp)); 
+	bool prev_alloc = GET_PREV_ALLOC(HDRP(bp)); 
+	bool next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp))); 
+	void *prev;
+	/* Case 1, a - a - a */
+	if (prev_alloc && next_alloc) {
+		if (debug_flag)
+			printf("coalesce: enter a - a - a\n");
+		if (debug_flag)
+			printblock(bp);  
+		if (debug_flag)
+			printf("coalesce: exit a - a - a\n");
+	/* Case 2, a - a - f */
+	} else if (prev_alloc && !next_alloc) {      
+		if (debug_flag)
+			printf("coalesce: enter a - a - f\n");
+		/* remove two blocks from the free list */
+		delete_block(bp);
+		delete_block(NEXT_BLKP(bp));
+		CURSOR_ABSORB(NEXT_BLKP(bp), bp);
+		STAT_INC(coalesces);
+
+		size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+		zero_absorbed(NEXT_BLKP(bp), GET_SIZE(HDRP(NEXT_BLKP(bp))));
+		PUT(HDRP(bp), PACK(size, PREV_ALLOC));
+		PUT(FTRP(bp), PACK(size, PREV_ALLOC));
+		/* add coalesced block to the free list */
+		insert_block(bp, size);
+		if (debug_flag)
+			printf("coalesce: exit a - a - f\n");
+	/* Case 3, f - a - a */
+	} else if (!prev_alloc && next_alloc) {    
+		if (debug_flag)
+			printf("coalesce: enter f - a - a\n");
+		delete_block(bp);
+		delete_block(PREV_BLKP(bp));
+		CURSOR_ABSORB(bp, PREV_BLKP(bp));
+		STAT_INC(coalesces);
+
+		prev = PREV_BLKP(bp);
+		size += GET_SIZE(HDRP(prev));
+		PUT(FTRP(bp), PACK(size, PREV_ALLOC));
+		PUT(HDRP(prev), PACK(size, PREV_ALLOC));
+		zero_absorbed(bp, GET_SIZE(HDRP(bp)));
+		bp = prev;
+
+		insert_block(bp, size);
+		if (debug_flag)
+			printf("coalesce: exit f - a - a\n");
+	/* Case 4, f - a - f */
+	} else {
+		if (debug_flag)
+			printf("coalesce: enter f - a - f\n");
+		delete_block(bp);
+		delete_block(NEXT_BLKP(bp));
+		delete_block(PREV_BLKP(bp));
+		CURSOR_ABSORB(bp, PREV_BLKP(bp));
+		CURSOR_ABSORB(NEXT_BLKP(bp), PREV_BLKP(bp));
+		STAT_INC(coalesces);
+
+		prev = PREV_BLKP(bp);
+		size += (GET_SIZE(HDRP(prev)) + 
+		    GET_SIZE(FTRP(NEXT_BLKP(bp))));
+		PUT(HDRP(prev), PACK(size, PREV_ALLOC));
+		PUT(FTRP(NEXT_BLKP(bp)), PACK(size, PREV_ALLOC));
+		/* The tags of "bp" locate the next block, so clear it first. */
+		zero_absorbed(NEXT_BLKP(bp), GET_SIZE(HDRP(NEXT_BLKP(bp))));
+		zero_absorbed(bp, GET_SIZE(HDRP(bp)));
+		bp = prev;
+
+		insert_block(bp, size);
+		if (debug_flag)
+			printf("coalesce: exit f - a - f\n");
+	}
+	return (bp);
+}
+/* 
+ * Requires:
+ *   In thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Extend the heap by "words" words, which the top chunk takes in, and
+ *   return the top chunk's address.
+ */
+static void *
+extend_heap(size_t words) 
+{
+	if (debug_flag) {
+		printf("*******+++++++============********\n");
+		printf("EXTEND_HEAP: ");
+		printf("extend_heap of size: %d words\n", (int)words);
+	}
+	size_t size;
+	void *bp;
+
+	/* Allocate an even number of words to maintain alignment. */
+	//size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
+	size = words * WSIZE;
+	if ((bp = heap_sbrk(size)) == (void *)-1)  
+		return (NULL);
+	STAT_INC(extends);
+
+	/*
+	 * Initialize free block header/footer and the epilogue header.  The
+	 * old epilogue header becomes the new block's header and still knows
+	 * whether the last block is allocated.
+	 */
+	PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp)))); /* Free block header */
+	PUT(FTRP(bp), GET(HDRP(bp)));             /* Free block footer */
+	PUT(HDRP(NEXT_BLKP(bp)), PACK(0, ALLOC)); /* New epilogue header */ 
+
+	/* The top chunk grows in place; otherwise the new space becomes it. */
+	if (ms->top == NULL) {
+		ms->top = bp;
+		return (bp);
+	}
+	zero_absorbed(bp, size);
+	bp = ms->top;
+	size += GET_SIZE(HDRP(bp));
+	PUT(HDRP(bp), PACK(size, GET_PREV_ALLOC(HDRP(bp))));
+	PUT(FTRP(bp), GET(HDRP(bp)));
+	return (bp);
+}
+
+/*
+ * Requires:
+ *   In thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Extend the heap so that the top chunk has at least "asize" bytes,
+ *   growing it by what it lacks but by no less than chunk_size.  Returns
+ *   the top chunk, or NULL if the heap cannot grow.
+ */
+static void *
+grow_top(size_t asize)
+{
+	size_t have = ms->top != NULL ? GET_SIZE(HDRP(ms->top)) : 0;
+
+	return (extend_heap(ALIGN_UP(MAX(asize - have, chunk_size)) / WSIZE));
+}
+
+/*
+ * Requires:
+ *   In thread-safe mode, the caller holds the lock of heap "ms".
+ *
+ * Effects:
+ *   Extend heap "ms" by "incr" bytes, or shrink it if "incr" is negative,
+ *   and return the old end of the heap, like mem_sbrk().  Returns
+ *   (void *)-1 if the heap cannot grow.  The main heap is memlib's; any
+ *   other arena's grows within the region it reserved.  Growth into memory
+ *   memlib knows to be zero extends the heap's zero tail.
+ */
+static void *
+heap_sbrk(intptr_t incr)
+{
+	char *old_brk = heap_end();
+	bool zero = false;
+
+#ifdef MM_ARENAS
+	if (ms->lo != NULL) {
+		if (incr > ms->max - old_brk)
+			return ((void *)-1);
+		ms->brk += incr;
+	} else
+#endif
+	{
+		zero = incr > 0 && mem_is_zero(old_brk, old_brk + incr - 1);
+		if ((old_brk = mem_sbrk(incr)) == (void *)-1)
+			return (old_brk);
+	}
+	/* The zero tail cannot reach past the end, or into dirty memory. */
+	if (incr < 0)
+		ms->zero_lo = MIN(ms->zero_lo, old_brk + incr);
+	else if (!zero) {
+		ms->zero_lo = old_brk + incr;
+		ms->zero_skips++;
+	}
+	return (old_brk);
+}
+
+/*
+ * Requires:
+ *   In thread-safe mode, the caller holds the lock of heap "ms".
+ *
+ * Effects:
+ *   Return the address just past the last byte of heap "ms".
+ */
+static char *
+heap_end(void)
+{
+#ifdef MM_ARENAS
+	if (ms->lo != NULL)
+		return (ms->brk);
+#endif
+	return ((char *)mem_heap_hi() + 1);
+}
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Find a fit for a block with "asize" bytes. Returns that block's address
+ *   or NULL if no suitable block was found. 
+ */
+static void *
+find_fit(size_t asize)
+{
+	if (debug_flag) {
+		printf("*******+++++++============********\n");
+		printf("FIND_FIT: \n");
+	}
+	int lst_idx = get_list_index(asize); 
+	if (debug_flag)
+		printf("find_fit: list_index: %d\n", lst_idx); 
+	struct free_block_body *bp;
+	/*
+	 * Look for the best fit in the tree of a large class, or a fit among
+	 * the first few blocks of the own class, as the policy picks it,
+	 * otherwise.
+	 */
+	if (lst_idx >= tree_lst)
+		bp = tree_best_fit(lst_idx, asize);
+	else
+		bp = policy->fit(lst_idx, asize);
+	if (bp != NULL)
+		return (bp);
+	/*
+	 * Otherwise every block of the next non-empty class is large enough,
+	 * except in the last class, which has no upper bound.  The smallest
+	 * block of a tree is the best fit, and the policy picks one of a list.
+	 */
+	if ((lst_idx = find_nonempty_list(lst_idx + 1)) >= 0) {
+		if (debug_flag)
+			printf("find_fit: Finding fit for block size: %d bytes, %d words; list_index: %d\n", 
+				(int)asize, (int)asize / 8, lst_idx);
+		if (lst_idx >= tree_lst)
+			bp = tree_best_fit(lst_idx, asize);
+		else if (lst_idx == seglst_lists - 1)
+			bp = find_block_from_list(ms->seg_lst[lst_idx], asize,
+			    -1);
+		else
+			bp = policy->fit(lst_idx, asize);
+		if (bp != NULL)
+			return (bp);
+	}
+	/* The top chunk is the last resort, so that it stays large. */
+	if (ms->top != NULL && GET_SIZE(HDRP(ms->top)) >= asize)
+		return (ms->top);
+	if (debug_flag)
+		printf("No available block found\n");
+	/* No fit was found. */
+	return (NULL);
+}
+/*
+ * Requires: 
+ *	Nothing
+ *
+ * Effects:
+ * 	find a block in seglist where block size is greater than or equal to 
+ *	asize, looking at no more than "limit" blocks unless "limit" is
+ *	negative
+ */
+static void *
+find_block_from_list(struct free_block_body *bp, int asize, int limit)
+{
+	if (debug_flag) {
+		printf("*******+++++++============********\n");
+		printf("FIND_BLOCK_FROM_LIST: \n");
+	}
+	assert(asize > 0);
+	if (bp == NULL) {
+		STAT_SEARCH(0);
+		return NULL;
+	}
+	size_t block_size;
+	int n = 0;
+	if (debug_flag) {
+		printf("find_block_from_list: asize: %d\n", asize);
+	}
+	while (bp != NULL && n != limit) {
+		if (debug_flag)
+			printblock(bp);
+		n++;
+		block_size = GET_SIZE(HDRP(bp)); 
+		if ((int) block_size >= asize) {
+			STAT_SEARCH(n);
+			return bp;
+		}
+		bp = NEXT_FREE(bp);
+	}
+	STAT_SEARCH(n);
+	return NULL;	
+}
+
+/*
+ * Requires:
+ *	"bp" was just pushed on the head of list "lst_indx", which has a
+ *	side index, and "size" is its size.
+ * Effects:
+ *	Push "bp" on the head of the list's side index, dropping the last
+ *	block if the index is full.
+ */
+static void
+side_insert(int lst_indx, void *bp, int size)
+{
+	struct side_index *si = SIDE_OF(lst_indx);
+
+	/* Shifting the whole index keeps the unused slots zero. */
+	memmove(&si->size[1], &si->size[0], sizeof(si->size) -
+	    sizeof(si->size[0]));
+	memmove(&si->blk[1], &si->blk[0], sizeof(si->blk) - sizeof(si->blk[0]));
+	si->size[0] = (uint16_t)size;
+	si->blk[0] = LINK(bp);
+	si->count = MIN(si->count + 1, FIT_SEARCH_LIMIT);
+}
+
+/*
+ * Requires:
+ *	"bp" was just unlinked from list "lst_indx", which has a side index.
+ * Effects:
+ *	Remove "bp" from the list's side index if it is there, and index the
+ *	block that moves up into the first FIT_SEARCH_LIMIT blocks instead.
+ */
+static void
+side_delete(int lst_indx, void *bp)
+{
+	struct side_index *si = SIDE_OF(lst_indx);
+	struct free_block_body *next;
+	link_t link = LINK(bp);
+	int i, n = si->count;
+
+	for (i = 0; i < n && si->blk[i] != link; i++)
+		;
+	if (i == n)
+		return;
+	memmove(&si->size[i], &si->size[i + 1], (FIT_SEARCH_LIMIT - i - 1) *
+	    sizeof(si->size[0]));
+	memmove(&si->blk[i], &si->blk[i + 1], (FIT_SEARCH_LIMIT - i - 1) *
+	    sizeof(si->blk[0]));
+	si->size[FIT_SEARCH_LIMIT - 1] = 0;
+	n--;
+	/* Only a full index can have more blocks behind it. */
+	if (si->count == FIT_SEARCH_LIMIT) {
+		next = n > 0 ? NEXT_FREE(UNLINK(si->blk[n - 1])) :
+		    ms->seg_lst[lst_indx];
+		if (next != NULL) {
+			si->size[n] = (uint16_t)GET_SIZE(HDRP(next));
+			si->blk[n++] = LINK(next);
+		}
+	}
+	si->count = n;
+}
+
+/*
+ * Requires:
+ *	List "lst_indx" has a side index, and "asize" is below TREE_MIN.
+ * Effects:
+ *	Return the first of the first FIT_SEARCH_LIMIT blocks of the list
+ *	that is at least "asize" bytes, or NULL if there is none, like
+ *	find_block_from_list(), but from the side index.
+ */
+static void *
+side_fit(int lst_indx, size_t asize)
+{
+	struct side_index *si = SIDE_OF(lst_indx);
+	int i;
+
+#if defined(__SSE2__) && FIT_SEARCH_LIMIT == 8
+	/* Compare all eight sizes at once; unused slots hold zero. */
+	__m128i sizes = _mm_loadu_si128((const __m128i *)si->size);
+	unsigned mask = _mm_movemask_epi8(_mm_cmpgt_epi16(sizes,
+	    _mm_set1_epi16((short)(asize - 1))));
+
+	i = mask != 0 ? __builtin_ctz(mask) / 2 : si->count;
+#else
+	for (i = 0; i < si->count && si->size[i] < asize; i++)
+		;
+#endif
+	if (i == si->count) {
+		STAT_SEARCH(si->count);
+		return (NULL);
+	}
+	STAT_SEARCH(i + 1);
+	return (UNLINK(si->blk[i]));
+}
+
+/*
+ * Requires:
+ *	"lst_indx" is the index of a seglist that holds a list.
+ * Effects:
+ *	Return the first of the first FIT_SEARCH_LIMIT blocks of the list
+ *	that is at least "asize" bytes, or NULL if there is none.
+ */
+static void *
+fit_first(int lst_indx, size_t asize)
+{
+
+	if (IS_SIDE_LIST(lst_indx))
+		return (side_fit(lst_indx, asize));
+	return (find_block_from_list(ms->seg_lst[lst_indx], (int)asize,
+	    FIT_SEARCH_LIMIT));
+}
+
+/*
+ * Requires:
+ *	"lst_indx" is the index of a seglist that holds a list.
+ * Effects:
+ *	Like fit_first(), but start from the list's rover and wrap around
+ *	to the head, so that successive searches spread over the list.  The
+ *	rover is left on the block returned.
+ */
+static void *
+fit_next(int lst_indx, size_t asize)
+{
+	struct free_block_body *bp, *start;
+	int n = 0;
+
+	start = ms->rover[lst_indx] != NULL ? ms->rover[lst_indx] :
+	    ms->seg_lst[lst_indx];
+	for (bp = start; bp != NULL && n < FIT_SEARCH_LIMIT; ) {
+		n++;
+		if (GET_SIZE(HDRP(bp)) >= asize) {
+			ms->rover[lst_indx] = bp;
+			STAT_SEARCH(n);
+			return (bp);
+		}
+		if ((bp = NEXT_FREE(bp)) == NULL)
+			bp = ms->seg_lst[lst_indx];
+		if (bp == start)
+			break;
+	}
+	STAT_SEARCH(n);
+	return (NULL);
+}
+
+/*
+ * Requires:
+ *	"lst_indx" is the index of a seglist that holds a list.
+ * Effects:
+ *	Return the smallest of the first FIT_SEARCH_LIMIT blocks of the list
+ *	that is at least "asize" bytes, or NULL if there is none.  An exact
+ *	fit ends the search.
+ */
+static void *
+fit_best(int lst_indx, size_t asize)
+{
+	struct free_block_body *bp, *best = NULL;
+	size_t size, best_size = SIZE_MAX;
+	int n = 0;
+
+	for (bp = ms->seg_lst[lst_indx]; bp != NULL && n < FIT_SEARCH_LIMIT;
+	    bp = NEXT_FREE(bp)) {
+		n++;
+		size = GET_SIZE(HDRP(bp));
+		if (size >= asize && size < best_size) {
+			best = bp;
+			best_size = size;
+			if (size == asize)
+				break;
+		}
+	}
+	STAT_SEARCH(n);
+	return (best);
+}
+
+/*
+ * Requires:
+ *	"anchor" is the address of an allocated heap block, and "asize" is
+ *	an adjusted block size.
+ * Effects:
+ *	Return a free block of at least "asize" bytes close to "anchor", or
+ *	NULL if there is none.  The free block before "anchor" and those
+ *	among the NEAR_BLOCKS blocks after it are found through the boundary
+ *	tags.  Otherwise the nearest of the first FIT_SEARCH_LIMIT blocks of
+ *	the first list below the trees with a fit is taken.
+ */
+static void *
+near_fit(void *anchor, size_t asize)
+{
+	struct free_block_body *bp, *best = NULL;
+	uintptr_t dist, best_dist = UINTPTR_MAX;
+	char *next;
+	int lst_indx, i, n;
+
+	if (!GET_PREV_ALLOC(HDRP(anchor)) &&
+	    GET_SIZE(HDRP(PREV_BLKP(anchor))) >= asize)
+		return (PREV_BLKP(anchor));
+	for (next = NEXT_BLKP(anchor), i = 0;
+	    i < NEAR_BLOCKS && GET_SIZE(HDRP(next)) > 0;
+	    next = NEXT_BLKP(next), i++) {
+		if (!GET_ALLOC(HDRP(next)) && GET_SIZE(HDRP(next)) >= asize)
+			return (next);
+	}
+	for (lst_indx = get_list_index(asize);
+	    lst_indx >= 0 && lst_indx < tree_lst && best == NULL;
+	    lst_indx = find_nonempty_list(lst_indx + 1)) {
+		n = 0;
+		for (bp = ms->seg_lst[lst_indx];
+		    bp != NULL && n < FIT_SEARCH_LIMIT; bp = NEXT_FREE(bp)) {
+			n++;
+			if (GET_SIZE(HDRP(bp)) < asize)
+				continue;
+			dist = (char *)bp > (char *)anchor ?
+			    (uintptr_t)((char *)bp - (char *)anchor) :
+			    (uintptr_t)((char *)anchor - (char *)bp);
+			if (dist < best_dist) {
+				best = bp;
+				best_dist = dist;
+			}
+		}
+		STAT_SEARCH(n);
+	}
+	return (best);
+}
+
+/*
+ * Requires:
+ *	"t" is the root of a tree of free blocks, or NULL.
+ *
+ * Effects:
+ *	Splay the tree "t" around the key ("size", "addr") and return the new
+ *	root, which is the node with that key if there is one, and otherwise
+ *	its predecessor or successor.  Nodes are ordered by block size and
+ *	then by address.  This is the top-down splay of Sleator and Tarjan.
+ */
+static struct free_tree_node *
+tree_splay(struct free_tree_node *t, size_t size, void *addr)
+{
+	struct free_tree_node *y;
+	/* The left and right trees, and the links their next nodes go in */
+	link_t lroot, rroot, *l, *r;
+
+	if (t == NULL)
+		return (NULL);
+	lroot = rroot = LINK(NULL);
+	l = &lroot;
+	r = &rroot;
+	for (;;) {
+		if (TREE_LESS(size, addr, t)) {
+			if (LEFT(t) == NULL)
+				break;
+			if (TREE_LESS(size, addr, LEFT(t))) {
+				/* rotate right */
+				y = LEFT(t);
+				t->left = y->right;
+				SET_RIGHT(y, t);
+				t = y;
+				if (LEFT(t) == NULL)
+					break;
+			}
+			/* link right */
+			*r = LINK(t);
+			r = &t->left;
+			t = LEFT(t);
+		} else if (TREE_MORE(size, addr, t)) {
+			if (RIGHT(t) == NULL)
+				break;
+			if (TREE_MORE(size, addr, RIGHT(t))) {
+				/* rotate left */
+				y = RIGHT(t);
+				t->right = y->left;
+				SET_LEFT(y, t);
+				t = y;
+				if (RIGHT(t) == NULL)
+					break;
+			}
+			/* link left */
+			*l = LINK(t);
+			l = &t->right;
+			t = RIGHT(t);
+		} else
+			break;
+	}
+	/* assemble */
+	*l = t->left;
+	*r = t->right;
+	t->left = lroot;
+	t->right = rroot;
+	return (t);
+}
+
+/*
+ * Requires:
+ *	"lst_indx" is the index of a seglist that holds a tree.
+ *
+ * Effects:
+ *	Return the smallest free block of at least "asize" bytes in the tree,
+ *	preferring the lowest address among equal sizes, or NULL if there is
+ *	none.  The tree is splayed around the search.
+ */
+static void *
+tree_best_fit(int lst_indx, size_t asize)
+{
+	struct free_tree_node *t;
+
+	if ((t = tree_splay(ms->seg_lst[lst_indx], asize, NULL)) == NULL)
+		return (NULL);
+	ms->seg_lst[lst_indx] = t;
+	if (GET_SIZE(HDRP(t)) >= asize)
+		return (t);
+	/* the root is the predecessor; the fit is the next node in order */
+	if ((t = RIGHT(t)) == NULL)
+		return (NULL);
+	while (LEFT(t) != NULL)
+		t = LEFT(t);
+	return (t);
+}
+
+/*
+ * Requires:
+ *	"lst_indx" is the index of a seglist that holds a tree and "bp" is a
+ *	free block that belongs to it.
+ *
+ * Effects:
+ *	Insert "bp" into the tree as its new root.
+ */
+static void
+tree_insert(int lst_indx, void *bp)
+{
+	struct free_tree_node *n = bp, *t;
+	size_t size = GET_SIZE(HDRP(bp));
+
+	t = tree_splay(ms->seg_lst[lst_indx], size, bp);
+	if (t == NULL) {
+		SET_LEFT(n, NULL);
+		SET_RIGHT(n, NULL);
+		ms->seg_map[lst_indx / 64] |= (uint64_t)1 << (lst_indx % 64);
+	} else if (TREE_LESS(size, bp, t)) {
+		n->left = t->left;
+		SET_RIGHT(n, t);
+		SET_LEFT(t, NULL);
+	} else {
+		n->right = t->right;
+		SET_LEFT(n, t);
+		SET_RIGHT(t, NULL);
+	}
+	ms->seg_lst[lst_indx] = n;
+}
+
+/*
+ * Requires:
+ *	"lst_indx" is the index of a seglist that holds a tree and "bp" is a
+ *	block in that tree.
+ *
+ * Effects:
+ *	Remove "bp" from the tree.
+ */
+static void
+tree_delete(int lst_indx, void *bp)
+{
+	struct free_tree_node *t;
+	size_t size = GET_SIZE(HDRP(bp));
+
+	t = tree_splay(ms->seg_lst[lst_indx], size, bp);
+	assert(t == bp);
+	if (LEFT(t) == NULL)
+		ms->seg_lst[lst_indx] = RIGHT(t);
+	else {
+		/* every key on the left is smaller, so its maximum has no
+		 * right child after the splay */
+		ms->seg_lst[lst_indx] = tree_splay(LEFT(t), size, bp);
+		((struct free_tree_node *)ms->seg_lst[lst_indx])->right =
+		    t->right;
+	}
+	if (ms->seg_lst[lst_indx] == NULL)
+		ms->seg_map[lst_indx / 64] &=
+		    ~((uint64_t)1 << (lst_indx % 64));
+}
+
+/*
+ * Requires:
+ *   "asize" is a multiple of ALIGN_SIZE and "align" is a power of two
+ *   that is at least ALIGN_SIZE.
+ *
+ * Effects:
+ *   Allocate a block of "asize" bytes whose payload address is a multiple
+ *   of "align".  The free space in front of the payload is split off into a
+ *   free block of its own.  Returns the address of the block, or NULL if
+ *   the heap could not be extended.
+ */
+static void *
+alloc_aligned(size_t asize, size_t align)
+{
+	struct free_block_body *bp;
+	char *start, *payload;
+	ptrdiff_t extend;
+	size_t csize, lead, prev_alloc;
+	int lst_idx, limit;
 
-		size_t next_block_size = GET_SIZE(HDRP(NEXT_BLKP(ptr)));
-		/* make size_diff multiple of 8 */ 
-		if (debug_flag) { 
-			printf("mm_realloc: next_block_size: %d\n", (int)next_block_size);
-			printf("mm_realloc: next_block_allocated: %d\n", (int)GET_ALLOC(HDRP(NEXT_BLKP(ptr))));
-			printf("mm_realloc: current_block_size: %d\n", (int)GET_SIZE(HDRP(ptr)));
+	/* Look for a free block that has room for an aligned payload. */
+search:
+	lst_idx = find_nonempty_list(get_list_index(asize));
+	while (lst_idx >= 0) {
+		/*
+		 * In a tree, try the best fit, then the best fit among blocks
+		 * large enough for any alignment.
+		 */
+		if (lst_idx >= tree_lst) {
+			if ((bp = tree_best_fit(lst_idx, asize)) != NULL &&
+			    (payload = aligned_fit(bp, asize, align)) != NULL)
+				goto found;
+			if ((bp = tree_best_fit(lst_idx,
+			    asize + align + 2 * DSIZE)) != NULL &&
+			    (payload = aligned_fit(bp, asize, align)) != NULL)
+				goto found;
+			lst_idx = find_nonempty_list(lst_idx + 1);
+			continue;
 		}
-		/* block next to current block is free */
-		if (!GET_ALLOC(HDRP(NEXT_BLKP(ptr)))) {
-			/* next free block has enough extra space to form a new free block */
-			if ((int)next_block_size >= (int)(abs(size_diff) + 2 * DSIZE)) {
-				if (debug_flag) { 
-					printf("mm_realloc: (int)next_block_size >= (int)(abs(size_diff) + 2 * DSIZE)\n");
-				}
-				delete_block(NEXT_BLKP(ptr));
-
-				PUT(HDRP(ptr), PACK(realloc_asize, 1));
-				PUT(FTRP(ptr), PACK(realloc_asize, 1));
+		limit = FIT_SEARCH_LIMIT;
+		for (bp = ms->seg_lst[lst_idx]; bp != NULL && limit-- > 0;
+		    bp = NEXT_FREE(bp)) {
+			if ((payload = aligned_fit(bp, asize, align)) != NULL)
+				goto found;
+		}
+		lst_idx = find_nonempty_list(lst_idx + 1);
+	}
+	if (ms->fast_count > 0) {
+		consolidate();
+		goto search;
+	}
+	/*
+	 * Extend the heap just enough for an aligned payload, starting from
+	 * the top chunk if there is one.
+	 */
+	start = ms->top != NULL ? ms->top : heap_end();
+	payload = aligned_payload(start, align);
+	extend = payload + asize - heap_end();
+	if (extend <= 0)
+		bp = (struct free_block_body *)start;
+	else if ((bp = extend_heap(MAX(extend, (ptrdiff_t)(2 * DSIZE)) /
+	    WSIZE)) == NULL)
+		return (NULL);
+found:
+	/* Split off the free space in front of and behind the payload. */
+	csize = GET_SIZE(HDRP(bp));
+	prev_alloc = GET_PREV_ALLOC(HDRP(bp));
+	lead = payload - (char *)bp;
+	delete_block(bp);
+	if (lead > 0) {
+		PUT(HDRP(bp), PACK(lead, prev_alloc));
+		PUT(FTRP(bp), GET(HDRP(bp)));
+		csize -= lead;
+		prev_alloc = 0;
+	}
+	if (csize - asize >= 2 * DSIZE) {
+		STAT_INC(splits);
+		PUT(HDRP(payload), PACK(asize, prev_alloc | ALLOC));
+		PUT(HDRP(NEXT_BLKP(payload)), PACK(csize - asize, PREV_ALLOC));
+		PUT(FTRP(NEXT_BLKP(payload)), PACK(csize - asize, PREV_ALLOC));
+		insert_block(NEXT_BLKP(payload), csize - asize);
+	} else {
+		PUT(HDRP(payload), PACK(csize, prev_alloc | ALLOC));
+		SET_PREV_ALLOC(HDRP(NEXT_BLKP(payload)));
+	}
+	/* The lead is linked once the payload's header bounds it. */
+	if (lead > 0)
+		insert_block(bp, lead);
+	mark_used(payload);
+	return (payload);
+}
 
-				ptr = NEXT_BLKP(ptr);
+/*
+ * Requires:
+ *   "align" is a power of two.
+ *
+ * Effects:
+ *   Return the lowest address from "bp" on that is a multiple of "align"
+ *   and is either "bp" itself or far enough past it for the space in
+ *   between to form a free block.
+ */
+static char *
+aligned_payload(void *bp, size_t align)
+{
+	uintptr_t addr = (uintptr_t)bp;
 
-				int new_next_block_size = (int)next_block_size - abs(size_diff);  
+	if (addr % align != 0)
+		addr += 2 * DSIZE;
+	return ((char *)((addr + align - 1) & ~(align - 1)));
+}
 
-				PUT(HDRP(ptr), PACK(new_next_block_size, 0)); 
-				PUT(FTRP(ptr), PACK(new_next_block_size, 0));  
-				insert_block(ptr, new_next_block_size);
+/*
+ * Requires:
+ *   "bp" is the address of a free block.
+ *
+ * Effects:
+ *   Return the lowest payload address in the free block "bp" that is a
+ *   multiple of "align" and leaves room for a block of "asize" bytes, with
+ *   any space in front of it large enough to form a free block.  Returns
+ *   NULL if there is no such address.
+ */
+static char *
+aligned_fit(void *bp, size_t asize, size_t align)
+{
+	char *payload = aligned_payload(bp, align);
 
-				coalesce(ptr);
+	if (payload + asize > (char *)bp + GET_SIZE(HDRP(bp)))
+		return (NULL);
+	return (payload);
+}
 
-				return (PREV_BLKP(ptr));
-			} 
-			/* next free block doesnot have enough extra space to form a new free block */
-			else if ((int)next_block_size >= abs(size_diff)) {
-				if (debug_flag) { 
-					printf("mm_realloc: (int)next_block_size >= abs(size_diff)\n");
-				}
-				delete_block(NEXT_BLKP(ptr));
+/*
+ * Requires:
+ *   0 < "size" <= SLAB_MAX.
+ *
+ * Effects:
+ *   Allocate an object of at least "size" bytes from a slab of its size
+ *   class, creating a new slab if every slab of the class is full.  Returns
+ *   the address of the object, or NULL if the heap could not be extended.
+ */
+static void *
+slab_malloc(size_t size)
+{
+	int cls = (size - 1) / ALIGN_SIZE;
+	struct slab *sp = ms->slab_lst[cls];
+	int idx;
 
-				PUT(HDRP(ptr), PACK((int)(oldsize + next_block_size), 1));
-				PUT(FTRP(ptr), PACK((int)(oldsize + next_block_size), 1));
+	if (sp == NULL) {
+		if ((sp = slab_new()) == NULL)
+			return (NULL);
+		sp->obj_size = (cls + 1) * ALIGN_SIZE;
+		sp->nobjs = (SLAB_SIZE - WSIZE - sizeof(struct slab)) /
+		    sp->obj_size;
+		sp->nfree = sp->nobjs;
+		memset(sp->free_map, 0, sizeof(sp->free_map));
+		for (idx = 0; idx < (int)sp->nobjs; idx++)
+			sp->free_map[idx / 64] |= (uint64_t)1 << (idx % 64);
+		sp->prev = NULL;
+		sp->next = NULL;
+		ms->slab_lst[cls] = sp;
+	}
+	return (slab_take(sp));
+}
 
-				return (ptr);
-			}
-		}
-		/* block next to current block is allocated */
-		/*
-		else {
-			// next block is end of heap 
-			if (next_block_size == 0) {
-				printf("mm_realloc: next_block is end of heap\n");
-				if (debug_flag) { 
-					printf("mm_realloc: next_block is end of heap\n");
-				}
-				int extend_heap_size = abs(size_diff);
+/*
+ * Requires:
+ *   "sp" is a slab with a free object.
+ *
+ * Effects:
+ *   Allocate the lowest free object of the slab "sp", which keeps the
+ *   slab compact, and return its address.
+ */
+static void *
+slab_take(struct slab *sp)
+{
+	int word, idx;
 
-				void *bp;
-				if ((bp = mem_sbrk(extend_heap_size)) == (void *)-1)
-					return (NULL); 
+	for (word = 0; sp->free_map[word] == 0; word++)
+		;
+	idx = word * 64 + __builtin_ctzll(sp->free_map[word]);
+	sp->free_map[word] &= sp->free_map[word] - 1;
+	if (--sp->nfree == 0)
+		slab_unlink(sp);
+	return (sp->objs + idx * sp->obj_size);
+}
 
-				PUT(HDRP(ptr), PACK(realloc_asize, 1));
-				PUT(FTRP(ptr), PACK(realloc_asize, 1));
-				PUT(HDRP(NEXT_BLKP(ptr)), PACK(0, 1)); // New epilogue header
+/*
+ * Requires:
+ *   "bp" is the address of an allocated slab object.
+ *
+ * Effects:
+ *   Free the object "bp".  A slab that becomes empty is returned to the
+ *   heap, unless it is the only slab of its class with a free object.
+ */
+static void
+slab_free(void *bp)
+{
+	struct slab *sp = SLAB_OF(bp);
+	int cls, idx;
 
-				return (ptr);
-			} 
-		}
-		*/
-	}  
-	if (debug_flag) { 
-		printf("mm_realloc: mm_malloc, mm_free\n");
+	if (sp->obj_size == 0) {
+		nursery_free(bp);
+		return;
 	}
-	newptr = mm_malloc(size);
-	/* If realloc() fails the original block is left untouched  */
-	if (newptr == NULL)
-		return (NULL);
-	if (debug_flag) {
-		printf("mm_realloc: before memcpy: print list 5\n");
-		printlist(5);
+	cls = sp->obj_size / ALIGN_SIZE - 1;
+	idx = ((char *)bp - sp->objs) / sp->obj_size;
+	assert(!(sp->free_map[idx / 64] & ((uint64_t)1 << (idx % 64))));
+	sp->free_map[idx / 64] |= (uint64_t)1 << (idx % 64);
+	/* A full slab has a free object again. */
+	if (sp->nfree++ == 0) {
+		sp->prev = NULL;
+		sp->next = ms->slab_lst[cls];
+		if (sp->next != NULL)
+			sp->next->prev = sp;
+		ms->slab_lst[cls] = sp;
 	}
-	if (size < oldsize)
-		oldsize = size;
-	memcpy(newptr, ptr, oldsize);
-	if (debug_flag) {
-		printf("mm_realloc: after memcpy: print list 5\n");
-		printlist(5);
+	if (sp->nfree == sp->nobjs && (sp->next != NULL || sp->prev != NULL)) {
+		slab_unlink(sp);
+		slab_release(sp);
 	}
-	/* Free the old block. */
-	mm_free(ptr);
-	return (newptr);
 }
 
-/* 
- * Requires: 
- *	bp is not null
- * Effects: 
- * 	Insert block bp to a specific seglist.
- * 	Insertaion order will base on block size
+/*
+ * Requires:
+ *   "sp" is on the list of slabs of its class.
+ *
+ * Effects:
+ *   Remove the slab "sp" from the list of slabs of its class.
  */
 static void
-insert_block(void *bp, int size)
+slab_unlink(struct slab *sp)
 {
-	if (debug_flag) {
-		printf("*******+++++++============********\n");
-		printf("INSERT_BLOCK: ");
-		printf("insert_block: block size %d bytes, %d words\n", size, size / 8);
-		printf("(int)GET_SIZE(HDRP(bp)): %d bytes\n", (int)GET_SIZE(HDRP(bp)));
-	}
-	assert(bp != NULL);
-	assert(size >= 0);
-	assert(size == (int)GET_SIZE(HDRP(bp)));
+	if (sp->prev != NULL)
+		sp->prev->next = sp->next;
+	else
+		ms->slab_lst[sp->obj_size / ALIGN_SIZE - 1] = sp->next;
+	if (sp->next != NULL)
+		sp->next->prev = sp->prev;
+	sp->next = NULL;
+	sp->prev = NULL;
+}
 
-	int lst_indx;
-	struct free_block_body *new_block, *start_block = NULL;
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Allocate a slab-sized block and mark its page as holding a slab.
+ *   Returns the slab, whose header is left for the caller to fill in, or
+ *   NULL if the heap could not be extended.
+ */
+static struct slab *
+slab_new(void)
+{
+	struct slab *sp;
+	uintptr_t page;
 
-	lst_indx = get_list_index(size);
-	if (debug_flag) {
-		printf("insert_block: lst_indx: %d\n", lst_indx);
+	if ((sp = alloc_aligned(SLAB_SIZE, SLAB_SIZE)) == NULL)
+		return (NULL);
+	/* Lock-free frees read the page bitmap concurrently. */
+	page = (uintptr_t)sp / SLAB_SIZE - slab_base_page;
+	__atomic_fetch_or(&slab_pages[page / 64], (uint64_t)1 << (page % 64),
+	    __ATOMIC_RELAXED);
+	return (sp);
+}
+
+/*
+ * Requires:
+ *   "sp" is a slab or nursery chunk without live objects that is on no
+ *   list.
+ *
+ * Effects:
+ *   Unmark the page of "sp" and return its block to the heap.
+ */
+static void
+slab_release(struct slab *sp)
+{
+	uintptr_t page = (uintptr_t)sp / SLAB_SIZE - slab_base_page;
+
+	__atomic_fetch_and(&slab_pages[page / 64],
+	    ~((uint64_t)1 << (page % 64)), __ATOMIC_RELAXED);
+	do_free(sp);
+}
+
+/*
+ * Requires:
+ *   "asize" is an adjusted block size of at most NURSERY_MAX bytes.
+ *
+ * Effects:
+ *   Bump a block of "asize" bytes off the current nursery chunk, moving on
+ *   to a new chunk if it is full.  Returns the address of the block, or
+ *   NULL if the heap could not be extended.
+ */
+static void *
+nursery_malloc(size_t asize)
+{
+	struct slab *sp = ms->nursery;
+	char *bp;
+
+	if (sp == NULL || sp->objs + sp->used + asize >
+	    (char *)sp + GET_SIZE(HDRP(sp)) - WSIZE) {
+		/* The full chunk is let go of with its last object. */
+		if ((sp = ms->nursery_spare) != NULL) {
+			ms->nursery_spare = sp->next;
+			ms->nursery_spares--;
+		} else if ((sp = slab_new()) == NULL)
+			return (NULL);
+		sp->next = NULL;
+		sp->prev = NULL;
+		sp->obj_size = 0;
+		sp->nobjs = 0;
+		sp->nfree = 0;
+		sp->used = ALIGN_SIZE - WSIZE;
+		ms->nursery = sp;
 	}
-	if (debug_flag) {
-		printf("insert_block: before insert_block: print list 4\n");
-		printlist(4);
+	bp = sp->objs + sp->used + WSIZE;
+	PUT(HDRP(bp), PACK(asize, ALLOC));
+	sp->used += asize;
+	sp->nobjs++;
+	return (bp);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of an allocated nursery block.
+ *
+ * Effects:
+ *   Free the nursery block "bp".  The current chunk takes back its newest
+ *   block and starts over once it is empty; any other chunk that empties
+ *   is kept as a spare, or returned to the heap if there are enough.
+ */
+static void
+nursery_free(void *bp)
+{
+	struct slab *sp = SLAB_OF(bp);
+	size_t size = GET_SIZE(HDRP(bp));
+
+	assert(GET_ALLOC(HDRP(bp)));
+	if (sp == ms->nursery && HDRP(bp) + size == sp->objs + sp->used) {
+		sp->used -= size;
+		sp->nobjs--;
+	} else {
+		PUT(HDRP(bp), PACK(size, 0));
+		sp->nfree++;
 	}
-	/* insert block to seglist with Last In First Out policy */
-	start_block = seg_lst[lst_indx];
+	if (sp->nfree < sp->nobjs)
+		return;
+	sp->used = ALIGN_SIZE - WSIZE;
+	sp->nobjs = 0;
+	sp->nfree = 0;
+	if (sp == ms->nursery)
+		return;
+	if (ms->nursery_spares < NURSERY_SPARE) {
+		sp->next = ms->nursery_spare;
+		ms->nursery_spare = sp;
+		ms->nursery_spares++;
+	} else
+		slab_release(sp);
+}
 
-	new_block = bp;
-	/* seglist been insert into is empty */
-	if (start_block == NULL) {
-		new_block->prev = NULL;
-		new_block->next = NULL;
-		seg_lst[lst_indx] = new_block;
+/*
+ * Requires:
+ *   "bp" is the address of a block of "asize" bytes just allocated, at
+ *   most NURSERY_MAX.
+ *
+ * Effects:
+ *   Sample the block's birth for the lifetime predictor, one block in
+ *   LIFE_PERIOD.  A sample younger than LIFE_SHORT allocations is never
+ *   evicted, and one that is older counts as long-lived.
+ */
+static void
+life_birth(void *bp, size_t asize)
+{
+	struct life_sample *ls = &ms->life_samples[LIFE_SLOT(bp)];
+
+	if (++ms->life_count % LIFE_PERIOD != 0) {
+		/* The sample here was freed without being seen. */
+		if (ls->bp == bp)
+			ls->bp = NULL;
+		return;
 	}
-	/* seglist been insert into is not empty */
-	else {
-		new_block->prev = NULL;
-		new_block->next = start_block;
-		start_block->prev = new_block;
-		seg_lst[lst_indx] = new_block;
+	if (ls->bp != NULL && ls->bp != bp) {
+		if (ms->life_clock - ls->birth < LIFE_SHORT)
+			return;
+		life_train(ls->cls, false);
 	}
-	if (debug_flag) {
-		printf("insert_block: after insert_block: print list 4\n");
-		printlist(4);
+	ls->bp = bp;
+	ls->birth = ms->life_clock;
+	ls->cls = asize / ALIGN_SIZE;
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of an allocated block that is being freed.
+ *
+ * Effects:
+ *   If "bp" was sampled, train the predictor with its lifetime.
+ */
+static void
+life_death(void *bp)
+{
+	struct life_sample *ls = &ms->life_samples[LIFE_SLOT(bp)];
+
+	if (ls->bp != bp)
+		return;
+	life_train(ls->cls, ms->life_clock - ls->birth < LIFE_SHORT);
+	ls->bp = NULL;
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of an allocated block that is moving elsewhere.
+ *
+ * Effects:
+ *   Drop the sample of "bp", if any, without training the predictor, so
+ *   that a later block at this address does not inherit its birth.
+ */
+static void
+life_forget(void *bp)
+{
+	struct life_sample *ls = &ms->life_samples[LIFE_SLOT(bp)];
+
+	if (ls->bp == bp)
+		ls->bp = NULL;
+}
+
+/*
+ * Requires:
+ *   0 <= "cls" < LIFE_CLASSES.
+ *
+ * Effects:
+ *   Move the score of blocks of "cls" units one step toward short-lived if
+ *   "short_lived", and all the way to long-lived otherwise.
+ */
+static void
+life_train(int cls, bool short_lived)
+{
+	signed char *score = &ms->life_score[cls];
+
+	if (!short_lived)
+		*score = -LIFE_SCORE;
+	else if (*score < LIFE_SCORE)
+		(*score)++;
+}
+
+/*
+ * Requires:
+ *   "size" is a multiple of ALIGN_SIZE that does not fit in the rest of
+ *   the arena's current chunk.
+ *
+ * Effects:
+ *   Move "arena" on to a chunk with room for "size" bytes and allocate
+ *   them.  The chunk after the current one is reused if it is big enough;
+ *   otherwise a new chunk is inserted after the current one.  Returns NULL
+ *   if memory cannot be obtained.
+ */
+static void *
+arena_grow(struct mm_arena *arena, size_t size)
+{
+	struct arena_chunk *chunk, *cur;
+	size_t csize;
+
+	cur = arena->cur;
+	chunk = cur != NULL ? cur->next : arena->first;
+	if (chunk == NULL || (size_t)(chunk->end - chunk->data) < size) {
+		csize = MAX(ARENA_CHUNK, sizeof(struct arena_chunk) + size);
+		if ((chunk = mm_malloc(csize)) == NULL)
+			return (NULL);
+		chunk->end = (char *)chunk + csize;
+		if (cur != NULL) {
+			chunk->next = cur->next;
+			cur->next = chunk;
+		} else {
+			chunk->next = arena->first;
+			arena->first = chunk;
+		}
 	}
+	arena->cur = chunk;
+	arena->next = chunk->data + size;
+	arena->end = chunk->end;
+	return (chunk->data);
+}
+
+/*
+ * Requires:
+ *   "size" is not zero, and "align" is a power of two from ALIGN_SIZE to
+ *   the page size.  In thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Map a region for a block of "size" bytes of payload whose address is a
+ *   multiple of "align".  Returns the address of the block, or NULL if no
+ *   region could be mapped.
+ */
+static void *
+map_alloc(size_t size, size_t align)
+{
+	size_t offset = (MAP_OFFSET + align - 1) & ~(align - 1);
+	size_t len = offset + size;
+	char *base, *bp;
+
+	if (len < size || (base = mem_map(len)) == (void *)-1)
+		return (NULL);
+	/* memlib rounds the region up to whole pages */
+	len = (len + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+	bp = base + offset;
+	PUT(base, len);
+	PUT(bp - DSIZE, offset);
+	PUT(HDRP(bp), PACK(0, ALLOC));
+	return (bp);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a mapped block.  In thread-safe mode, the
+ *   caller holds the heap lock.
+ *
+ * Effects:
+ *   Unmap the region of the block "bp".
+ */
+static void
+map_free(void *bp)
+{
+	char *base = MAP_BASE(bp);
+
+	mem_unmap(base, GET(base));
 }
 
-/* 
+/*
  * Requires:
- *	nothing
+ *   "bp" is the address of a mapped block.
+ *
  * Effects:
- *	return the seglist index based on size of insert block
+ *   Return the number of payload bytes the block "bp" can hold.
  */
-static int
-get_list_index(int size)
+static size_t
+map_usable_size(void *bp)
 {
-	if (debug_flag) {
-		printf("*******+++++++============********\n");
-		printf("GET_LIST_INDEX: \n");
-	}
-	assert(size >= 0);
-	int count = size;
-	int list; 
-	if (debug_flag) {
-		printf("get_list_index: size: %d\n", size); 
-		printf("get_list_index: reached_1\n"); 
-	}
+	char *base = MAP_BASE(bp);
 
-	for (list = 0; list < SEGLST_NUM; list ++) {   
-		if ((count <= LOW_BOUND) || (list == SEGLST_NUM - 1)) { 
-			return list;
-		} 
-		/* divide count by 2 */
-		count = count >> 1;  
-	}
-	if (debug_flag) {
-		printf("get_list_index: block insert into last seglist");
-	}
+	return (GET(base) - ((char *)bp - base));
+}
 
-	return SEGLST_NUM - 1;
+/*
+ * Requires:
+ *   "bp" is the address of an allocated block or slab object.
+ *
+ * Effects:
+ *   Return the number of payload bytes available at "bp".
+ */
+static size_t
+usable_size(void *bp)
+{
+	if (is_slab(bp) && SLAB_OF(bp)->obj_size != 0)
+		return (SLAB_OF(bp)->obj_size);
+	if (IS_MAPPED(bp))
+		return (map_usable_size(bp));
+	return (GET_SIZE(HDRP(bp)) - WSIZE);
 }
 
 /*
  * Requires:
- *	Nothing
+ *   "bp" is the address of an allocated block or slab object.
+ *
  * Effects:
- * 	remove free block bp from the specific seglist
+ *   Return true if "bp" is a slab object.
  */
-static void
-delete_block(void *bp) {
+static bool
+is_slab(void *bp)
+{
+	uintptr_t page = (uintptr_t)bp / SLAB_SIZE - slab_base_page;
 
-	if (debug_flag) {
-		printf("*******+++++++============********\n");
-		printf("DELETE_BLOCK: \n");
-	}
-	assert(bp != NULL);
+	return ((__atomic_load_n(&slab_pages[page / 64], __ATOMIC_RELAXED) >>
+	    (page % 64)) & 1);
+}
 
-	struct free_block_body *curr_block;
-	struct free_block_body *smaller_block;
-	struct free_block_body *bigger_block; 
-	int lst_indx;
-	size_t block_size;
-	/* get size of the block */
-	block_size = GET_SIZE(HDRP(bp));
-	if (debug_flag) { 
-		printf("delete_block: size of the block to delete: %d\n", (int)block_size);
-	}
-	/* get seglist index */
-	lst_indx = get_list_index(block_size);
-	if (debug_flag) { 
-		printf("delete_block: index of seglist: %d\n", lst_indx);
-	}
-	curr_block = (struct free_block_body *)bp;
-	bigger_block = curr_block->prev;
-	smaller_block = curr_block->next; 
-	
-	if (debug_flag) {
-		printf("delete_block: before delete: print list 5\n");
-		printlist(5);
-	}
+#ifdef MM_THREADS
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Return the calling thread's block cache, emptying it first if its
+ *   blocks belong to a heap that has since been reinitialized.
+ */
+static struct tcache *
+tcache_self(void)
+{
+	struct tcache *tc = &tcache;
+	unsigned long gen = __atomic_load_n(&heap_gen, __ATOMIC_ACQUIRE);
 
-	/* block to delete has no block preceeding it */
-	if (bigger_block == NULL) { 
-		/* block to delete has no block after it */
-		if (smaller_block == NULL) {
-			seg_lst[lst_indx] = NULL;
-			if (debug_flag) { 
-				printf("delete_block: no left no right\n");
-			}
-		}
-		/* block to delete has block after it */
-		else {
-			if (debug_flag) { 
-				printf("delete_block: no left has right\n");
-			}
-			smaller_block->prev = NULL;
-			seg_lst[lst_indx] = smaller_block;
-		}
-	/* block to delete has block preceeding it */
-	} else { 
-		/* block to delete has no block after it */
-		if (smaller_block == NULL) {
-			if (debug_flag) { 
-				printf("delete_block: has left not right\n");
-			}
-			bigger_block->next = NULL;
-		}
-		/* block to delete has block after it */
-		else {
-			if (debug_flag) { 
-				printf("delete_block: has left has right\n");
-			}
-			bigger_block->next = smaller_block;
-			if (debug_flag) { 
-				printf("delete_block: inside_if_2_2_1\n");
-			}
-			smaller_block->prev = bigger_block;
-			if (debug_flag) { 
-				printf("delete_block: inside_if_2_2_2\n");
-			}
+	if (tc->gen != gen) {
+		if (tc->gen == 0) {
+			/* First use: arrange for the cache to be flushed at exit. */
+			pthread_once(&tcache_once, tcache_key_init);
+			pthread_setspecific(tcache_key, tc);
 		}
+		memset(tc->bins, 0, sizeof(tc->bins));
+		memset(tc->counts, 0, sizeof(tc->counts));
+		tc->gen = gen;
+#ifdef MM_ARENAS
+		/* Assign the thread to the next arena. */
+		tc->arena = &arenas[__atomic_fetch_add(&next_arena, 1,
+		    __ATOMIC_RELAXED) % NARENAS];
+		if (!arena_setup(tc->arena))
+			tc->arena = &arenas[0];
+#endif
 	}
-	if (debug_flag) {
-		printf("delete_block: after delete: print list 5\n");
-		printlist(5);
-	}
+	return (tc);
 }
 
 /*
- * The following routines are internal helper routines.
- */
-/* 
  * Requires:
- *   "bp" is the address of a free block that is at least "asize" bytes.
+ *   "bp" is the address of an allocated block that the caller owns.
  *
  * Effects:
- *   Place a block of "asize" bytes at the start of the free block "bp" and
- *   split that block if the remainder would be at least the minimum block
- *   size. 
+ *   Push "bp" onto the cache bin for its payload size.  Returns false, leaving
+ *   "bp" untouched, if the block is too large to be cached or its bin is
+ *   already full.
  */
-static void *
-place(void *bp, size_t asize)
+static bool
+tcache_put(struct tcache *tc, void *bp)
 {
-	if (debug_flag) {
-		printf("*******+++++++============********\n");
-		printf("PLACE: \n");
-	}
-	size_t csize = GET_SIZE(HDRP(bp));   
-	if (debug_flag) { 
-		printf("place: free block size: %d\n", (int)csize);
-		printblock(bp); 
-		printf("place: block size to place: %d\n", (int)asize);
-	}
-	if (check_block_flag) {
-		checkheap(false);
-		checklist();
-	}
-	// if ((csize - asize) >= (2 * DSIZE)) { 
-	/*
-	 * a block has to contain header, footer and at least two words for 
-	 * the forward link and backward link
-	 */
-	if (debug_flag) {
-		printf("place: before place: print list 4\n");
-		printlist(4);
-		printf("place: outside_debug_flag\n");
-	}
-	if (debug_flag) {
-		printf("place: reached\n"); 
-	}
-	/* block has remainder that qualify another free block */
-	if ((csize - asize) >= (2 * WSIZE + DSIZE)) {  
-		delete_block(bp); 
-		/* case for trace file binary-bal.rep; binary2-bal.rep */
-		if ((int)asize != 128) {   // (int)asize != 464 && 
-			PUT(HDRP(bp), PACK(asize, 1));
-			PUT(FTRP(bp), PACK(asize, 1)); 
-
-			bp = NEXT_BLKP(bp); 
-			
-			PUT(HDRP(bp), PACK(csize - asize, 0));
-			PUT(FTRP(bp), PACK(csize - asize, 0)); 
-
-			insert_block(bp, (int)(csize - asize)); 
-
-			return (PREV_BLKP(bp));
-		}
-		else { 
-			PUT(HDRP(bp), PACK(csize - asize, 0));
-			PUT(FTRP(bp), PACK(csize - asize, 0));  
+	size_t idx = usable_size(bp) / WSIZE;
 
-			insert_block(bp, (int)(csize - asize)); 
-
-			bp = NEXT_BLKP(bp); 
+	if (idx >= TCACHE_BINS || tc->counts[idx] >= TCACHE_LIMIT)
+		return (false);
+	*(void **)bp = tc->bins[idx];
+	tc->bins[idx] = bp;
+	tc->counts[idx]++;
+	return (true);
+}
 
-			PUT(HDRP(bp), PACK(asize, 1));
-			PUT(FTRP(bp), PACK(asize, 1));  
+/*
+ * Requires:
+ *   The caller holds the heap lock.
+ *
+ * Effects:
+ *   Return up to "count" blocks from cache bin "idx" to the shared lists.
+ *   In multi-arena mode, blocks of other arenas go on their remote free
+ *   queues instead.
+ */
+static void
+tcache_flush(struct tcache *tc, size_t idx, int count)
+{
+	void *bp;
+#ifdef MM_ARENAS
+	struct mstate *owner;
+#endif
 
-			return (bp); 
-		}
-	}
-	/* block doesnot has remainder that qualify another free block */ 
-	else {
-		if (debug_flag) {
-			printf("place_reached_ELSE: \n");
-			printf("place: csize: %d\n", (int)csize);
+	while (count-- > 0 && (bp = tc->bins[idx]) != NULL) {
+		tc->bins[idx] = *(void **)bp;
+		tc->counts[idx]--;
+#ifdef MM_ARENAS
+		if ((owner = arena_of(bp)) != ms) {
+			remote_free(owner, bp);
+			continue;
 		}
-		delete_block(bp);
-
-		PUT(HDRP(bp), PACK(csize, 1));
-		PUT(FTRP(bp), PACK(csize, 1));
-
-		return (bp);
-	}
-	if (debug_flag) {
-		printf("place: after place: print list 4\n");
-		printlist(4);
+#endif
+		do_free(bp);
 	}
 }
+
 /*
  * Requires:
- *   "bp" is the address of a newly freed block.
+ *   None.
  *
  * Effects:
- *   Perform boundary tag coalescing. Returns the address of the coalesced
- *   block.
+ *   Create the key whose destructor flushes a thread's cache at exit.
  */
-static void *
-coalesce(void *bp) 
+static void
+tcache_key_init(void)
 {
-	if (debug_flag) {
-		printf("*******+++++++============********\n");
-		printf("COALESCE: \n");
-	}
-	size_t size = GET_SIZE(HDRP(bp)); 
-	bool prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp))); 
-	bool next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp))); 
-	/* Case 1, a - a - a */
-	if (prev_alloc && next_alloc) {
-		if (debug_flag)
-			printf("coalesce: enter a - a - a\n");
-		if (debug_flag)
-			printblock(bp);  
-		if (debug_flag)
-			printf("coalesce: exit a - a - a\n");
-	/* Case 2, a - a - f */
-	} else if (prev_alloc && !next_alloc) {      
-		if (debug_flag)
-			printf("coalesce: enter a - a - f\n");
-		/* remove two blocks from the free list */
-		delete_block(bp);
-		delete_block(NEXT_BLKP(bp));
-
-		size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
-		PUT(HDRP(bp), PACK(size, 0));
-		PUT(FTRP(bp), PACK(size, 0));
-		/* add coalesced block to the free list */
-		insert_block(bp, size);
-		if (debug_flag)
-			printf("coalesce: exit a - a - f\n");
-	/* Case 3, f - a - a */
-	} else if (!prev_alloc && next_alloc) {    
-		if (debug_flag)
-			printf("coalesce: enter f - a - a\n");
-		delete_block(bp);
-		delete_block(PREV_BLKP(bp));
-
-		size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-		PUT(FTRP(bp), PACK(size, 0));
-		PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-		bp = PREV_BLKP(bp);
-
-		insert_block(bp, size);
-		if (debug_flag)
-			printf("coalesce: exit f - a - a\n");
-	/* Case 4, f - a - f */
-	} else {
-		if (debug_flag)
-			printf("coalesce: enter f - a - f\n");
-		delete_block(bp);
-		delete_block(NEXT_BLKP(bp));
-		delete_block(PREV_BLKP(bp));
+	pthread_key_create(&tcache_key, tcache_destroy);
+}
 
-		size += (GET_SIZE(HDRP(PREV_BLKP(bp))) + 
-		    GET_SIZE(FTRP(NEXT_BLKP(bp))));
-		PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-		PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-		bp = PREV_BLKP(bp);
+/*
+ * Requires:
+ *   "arg" is the exiting thread's cache.
+ *
+ * Effects:
+ *   Return every block still in the cache to the shared lists.
+ */
+static void
+tcache_destroy(void *arg)
+{
+	struct tcache *tc = arg;
+	size_t idx;
 
-		insert_block(bp, size);
-		if (debug_flag)
-			printf("coalesce: exit f - a - f\n");
+#ifdef MM_ARENAS
+	ms = tc->arena;
+#endif
+	LOCK();
+	if (tc->gen == heap_gen) {
+		for (idx = 0; idx < TCACHE_BINS; idx++)
+			tcache_flush(tc, idx, TCACHE_LIMIT);
 	}
-	return (bp);
+	UNLOCK();
 }
-/* 
+#endif /* MM_THREADS */
+
+#ifdef MM_ARENAS
+/*
  * Requires:
  *   None.
  *
  * Effects:
- *   Extend the heap with a free block and return that block's address.
+ *   Return the arena of the calling thread.
  */
-static void *
-extend_heap(size_t words) 
+static struct mstate *
+arena_self(void)
 {
-	if (debug_flag) {
-		printf("*******+++++++============********\n");
-		printf("EXTEND_HEAP: ");
-		printf("extend_heap of size: %d words\n", (int)words);
-	}
-	size_t size;
-	void *bp;
 
-	/* Allocate an even number of words to maintain alignment. */
-	//size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
-	size = words * WSIZE;
-	if ((bp = mem_sbrk(size)) == (void *)-1)  
+	return (tcache_self()->arena);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of an allocated block or slab object.
+ *
+ * Effects:
+ *   Return the arena whose heap holds "bp", or NULL if "bp" is a mapped
+ *   block, which belongs to no heap.
+ */
+static struct mstate *
+arena_of(void *bp)
+{
+	uintptr_t page;
+
+	if (!is_slab(bp) && IS_MAPPED(bp))
 		return (NULL);
-
-	/* Initialize free block header/footer and the epilogue header. */
-	PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
-	PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
-	PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */ 
-
-	insert_block(bp, GET_SIZE(HDRP(bp)));
-	/* Coalesce if the previous block was free. */
-	return (coalesce(bp));
+	page = (uintptr_t)bp / SLAB_SIZE - slab_base_page;
+	return (&arenas[__atomic_load_n(&arena_pages[page], __ATOMIC_RELAXED)]);
 }
+
 /*
  * Requires:
- *   None.
+ *   "m" is one of the arenas.
  *
  * Effects:
- *   Find a fit for a block with "asize" bytes. Returns that block's address
- *   or NULL if no suitable block was found. 
+ *   Set up the heap of arena "m" unless it already has one, reserving a
+ *   region of ARENA_HEAP bytes for it.  Returns false if the region
+ *   cannot be mapped or the heap cannot be created in it.
  */
-static void *
-find_fit(size_t asize)
+static bool
+arena_setup(struct mstate *m)
 {
-	if (debug_flag) {
-		printf("*******+++++++============********\n");
-		printf("FIND_FIT: \n");
-	}
-	int i;
-	int lst_idx = get_list_index(asize); 
-	if (debug_flag)
-		printf("find_fit: list_index: %d\n", lst_idx); 
-	struct free_block_body *bp;
-	/* Search for the first fit from the lists with index lst_idx or bigger */
-	for (i = lst_idx; i < SEGLST_NUM; i ++) {
-		
-		bp = seg_lst[i];
-		if (debug_flag) {
-			printf("find_fit: list_index: %d\n", i); 
-			if (bp != NULL)
-				printblock(bp);
-		}
-		if ((bp = find_block_from_list(bp, asize)) != NULL) {
-			if (debug_flag)
-				printf("find_fit: Finding fit for block size: %d bytes, %d words; list_index: %d\n", 
-					(int)asize, (int)asize / 8, i);
-			return bp;
+	struct mstate *self = ms;
+	uintptr_t page;
+	bool ok = true;
+
+	if (m == &arenas[0])
+		return (true);
+	ms = m;
+	LOCK();
+	if (m->heap_listp == NULL) {
+		if ((m->lo = mem_map(ARENA_HEAP)) == (void *)-1) {
+			m->lo = NULL;
+			ok = false;
+		} else {
+			m->brk = m->lo;
+			m->max = m->lo + ARENA_HEAP;
+			for (page = (uintptr_t)m->lo / SLAB_SIZE;
+			    page < (uintptr_t)m->max / SLAB_SIZE; page++)
+				__atomic_store_n(&arena_pages[page -
+				    slab_base_page], (uint8_t)(m - arenas),
+				    __ATOMIC_RELAXED);
+			ok = heap_setup() == 0;
 		}
 	}
-	if (debug_flag)
-		printf("No available block found\n");
-	/* No fit was found. */
-	return (NULL);
+	UNLOCK();
+	ms = self;
+	return (ok);
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of an allocated block or slab object of arena "m"
+ *   that the caller owns.
+ *
+ * Effects:
+ *   Push "bp" onto the remote free queue of arena "m" without locking.
+ *   Any number of threads may push at once.
+ */
+static void
+remote_free(struct mstate *m, void *bp)
+{
+	void *head = __atomic_load_n(&m->remote, __ATOMIC_RELAXED);
+
+	do
+		*(void **)bp = head;
+	while (!__atomic_compare_exchange_n(&m->remote, &head, bp, true,
+	    __ATOMIC_RELEASE, __ATOMIC_RELAXED));
 }
+
 /*
- * Requires: 
- *	Nothing
+ * Requires:
+ *   The caller holds the lock of arena "ms".
  *
  * Effects:
- * 	find a block in seglist where block size is greater than or equal to 
- *	asize
+ *   Free every block on the remote free queue of arena "ms".  The whole
+ *   queue is taken at once, so pushes never race with the pops.
  */
-static void *
-find_block_from_list(struct free_block_body *bp, int asize)
+static void
+remote_drain(void)
 {
-	if (debug_flag) {
-		printf("*******+++++++============********\n");
-		printf("FIND_BLOCK_FROM_LIST: \n");
-	}
-	assert(asize > 0);
-	if (bp == NULL) 
-		return NULL;
-	size_t block_size;
-	if (debug_flag) {
-		printf("find_block_from_list: asize: %d\n", asize);
-	}
-	while (bp != NULL) {
-		if (debug_flag)
-			printblock(bp);
-		block_size = GET_SIZE(HDRP(bp)); 
-		if ((int) block_size >= asize)
-			return bp;
-		bp = bp->next;
+	void *bp, *next;
+
+	bp = __atomic_exchange_n(&ms->remote, NULL, __ATOMIC_ACQUIRE);
+	for (; bp != NULL; bp = next) {
+		next = *(void **)bp;
+		do_free(bp);
 	}
-	return NULL;	
 }
+#endif /* MM_ARENAS */
 
 /* 
  * The remaining routines are heap consistency checker routines. 
@@ -920,35 +4474,71 @@ static void
 checkblock(void *bp) 
 {
 
-	if ((uintptr_t)bp % WSIZE) {
+	if ((uintptr_t)bp % ALIGN_SIZE) {
 		printf("Error: %p is not doubleword aligned\n", bp);
 		exit(1);
 	}
-	if (GET(HDRP(bp)) != GET(FTRP(bp))) {
-		printf("Error: header does not match footer\n");
-		exit(1);
-	}
 	if ((int)GET_ALLOC(HDRP(bp)) == 0) {
+		/* only free blocks carry a footer */
+		if (GET(HDRP(bp)) != GET(FTRP(bp))) {
+			printf("Error: header does not match footer\n");
+			exit(1);
+		}
 		/* check any contiguous free blocks that escaped coalescing */
-		if ((int)GET_ALLOC(HDRP(PREV_BLKP(bp))) != 1 || 
+		if (!GET_PREV_ALLOC(HDRP(bp)) || 
 			(int)GET_ALLOC(HDRP(NEXT_BLKP(bp))) != 1) {
 			printf("Error: contiguous free block escaped coalescing\n");
 			exit(1);
 		}
-		/* verify every free block actually in the free list */
-		int lst_indx = get_list_index(GET_SIZE(HDRP(bp)));
-		struct free_block_body *sl = seg_lst[lst_indx];
-		bool flag = false;
-		while (sl != NULL) {
-			if (sl == bp)
-				flag = true;
-			sl = sl->next;
-		}
-		if (flag == false) {
-			printf("Error: free block not in the free list\n");
+		/* verify every free block but the top chunk actually in the
+		 * free list; checklist verifies that the listed bitmap matches
+		 * the lists */
+		if (bp == ms->top ? GET_LISTED(bp) : !GET_LISTED(bp)) {
+			printf("Error: free block %s the free list\n",
+			    bp == ms->top ? "top chunk in" : "not in");
 			exit(1);
 		}
+	} else if (is_listed(bp)) {
+		printf("Error: allocated block %p is in the free list\n", bp);
+		exit(1);
+	}
+	/* a movable block is allocated and its handle points back to it */
+	if (GET_HANDLE(bp) &&
+	    (!GET_ALLOC(HDRP(bp)) || HANDLE_OF(bp)->bp != bp)) {
+		printf("Error: movable block %p does not match its handle\n", bp);
+		exit(1);
+	}
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a block on the heap.
+ *
+ * Effects:
+ *   Check that "bp" keeps to the zero tail of the heap: an allocated block
+ *   must end below it, and a free block's bytes within it must be zero
+ *   apart from the links and footer.
+ */
+static void
+checkzero(void *bp)
+{
+	char *p;
 
+	if (GET_ALLOC(HDRP(bp))) {
+		if (HDRP(NEXT_BLKP(bp)) > ms->zero_lo) {
+			printf("Error: allocated block %p extends into the zero "
+			    "tail at %p\n", bp, (void *)ms->zero_lo);
+			exit(1);
+		}
+		return;
+	}
+	p = MAX((char *)bp + LINKS_SIZE, ms->zero_lo);
+	for (; p < FTRP(bp); p++) {
+		if (*p != 0) {
+			printf("Error: free block %p holds a nonzero byte at %p "
+			    "in the zero tail\n", bp, (void *)p);
+			exit(1);
+		}
 	}
 }
 
@@ -963,19 +4553,42 @@ void
 checkheap(bool verbose) 
 { 
 	void *bp;
+	size_t prev_alloc = PREV_ALLOC;
+	int i, nfast;
 
 	if (verbose)
-		printf("Heap (%p):\n", heap_listp);
+		printf("Heap (%p):\n", ms->heap_listp);
 	/* check heap prologue */
-	if (GET_SIZE(HDRP(heap_listp)) != DSIZE || !GET_ALLOC(HDRP(heap_listp)))
+	if (GET_SIZE(HDRP(ms->heap_listp)) != PROLOGUE_SIZE ||
+	    !GET_ALLOC(HDRP(ms->heap_listp)))
 		printf("Bad prologue header\n");
 
-	checkblock(heap_listp);
+	checkblock(ms->heap_listp);
 	/* perform consistency check on every block on the heap */
-	for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
+	for (bp = ms->heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp)) {
 		if (verbose)
 			printblock(bp);
 		checkblock(bp);
+		/* the previous-allocated bit must track the block before */
+		if (GET_PREV_ALLOC(HDRP(bp)) != prev_alloc) {
+			printf("Error: %p has a stale previous-allocated bit\n",
+			    bp);
+			exit(1);
+		}
+		prev_alloc = GET_ALLOC(HDRP(bp)) ? PREV_ALLOC : 0;
+		if (GET_ALLOC(HDRP(bp)) && is_slab(bp))
+			checkslab(bp);
+		checkzero(bp);
+	}
+	if (GET_PREV_ALLOC(HDRP(bp)) != prev_alloc) {
+		printf("Error: epilogue has a stale previous-allocated bit\n");
+		exit(1);
+	}
+	/* the top chunk is the free block that ends the heap, if any */
+	if (ms->top != (prev_alloc ? NULL : PREV_BLKP(bp))) {
+		printf("Error: top chunk %p does not end the heap\n",
+		    (void *)ms->top);
+		exit(1);
 	}
 
 	if (verbose)
@@ -985,6 +4598,23 @@ checkheap(bool verbose)
 		printf("Bad epilogue header\n");
 		exit(1);
 	} 
+	/* blocks in the fast bins stay allocated and match their bin */
+	for (i = 0, nfast = 0; i < FAST_BINS; i++) {
+		for (bp = ms->fast_bins[i]; bp != NULL; bp = *(void **)bp) {
+			if (!GET_ALLOC(HDRP(bp)) ||
+			    GET_SIZE(HDRP(bp)) != (size_t)i * ALIGN_SIZE) {
+				printf("Error: %p does not belong in fast bin "
+				    "%d\n", bp, i);
+				exit(1);
+			}
+			nfast++;
+		}
+	}
+	if (nfast != ms->fast_count) {
+		printf("Error: fast bins hold %d blocks, not %d\n", nfast,
+		    ms->fast_count);
+		exit(1);
+	}
 }
 /* 
  * Requires:
@@ -995,12 +4625,36 @@ checkheap(bool verbose)
  */
 static void
 checklist() { 
-	int i;
+	int i, nlisted = 0;
 	struct free_block_body *bp;
 
-	for (i = 0; i < SEGLST_NUM; i ++) {
-		bp = seg_lst[i];
+	for (i = 0; i < seglst_lists; i ++) {
+		bp = ms->seg_lst[i];
+		/* verify the bitmap agrees on whether the list is empty */
+		if (((ms->seg_map[i / 64] >> (i % 64)) & 1) != (bp != NULL)) {
+			printf("Error: bitmap out of sync for seglist %d\n", i);
+			exit(1);
+		}
+		if (i >= tree_lst) {
+			nlisted += checktree((struct free_tree_node *)bp, NULL,
+			    NULL, i);
+			continue;
+		}
+		if (IS_SIDE_LIST(i))
+			checkside(i);
+		/* verify the rover rests on a block of this list */
+		if (ms->rover[i] != NULL && (!is_listed(ms->rover[i]) ||
+		    get_list_index(GET_SIZE(HDRP(ms->rover[i]))) != i)) {
+			printf("Error: rover of seglist %d is not on it\n", i);
+			exit(1);
+		}
 		while (bp != NULL) {
+			if (!is_listed(bp)) {
+				printf("Error: %p is missing from the listed "
+				    "bitmap\n", (void *)bp);
+				exit(1);
+			}
+			nlisted++;
 			/* verify every block in the free list marked as free */
 			if ((int)GET_ALLOC(HDRP(bp)) != 0 || 
 				(int)GET_ALLOC(FTRP(bp)) != 0) {
@@ -1010,16 +4664,28 @@ checklist() {
 			}
 			/* verify pointers in the free list point to valid 
 			 * free blocks */
-			struct free_block_body *next_block = bp->next;
-			struct free_block_body *prev_block = bp->prev;
+			struct free_block_body *next_block = NEXT_FREE(bp);
+			struct free_block_body *prev_block = PREV_FREE(bp);
 			if (next_block != NULL)
 				checkfreeblock(next_block);
+			/* verify address order where the policy keeps it */
+			if (policy == &policies[MM_POLICY_ADDRESS] &&
+			    next_block != NULL && next_block < bp) {
+				printf("Error: seglist %d is out of address "
+				    "order at %p\n", i, (void *)bp);
+				exit(1);
+			}
 			if (prev_block != NULL)
 			checkfreeblock(prev_block); 
 
-			bp = bp->next;
+			bp = NEXT_FREE(bp);
 		}
 	} 
+	if (nlisted != ms->listed_count) {
+		printf("Error: free lists hold %d blocks, not %d\n", nlisted,
+		    ms->listed_count);
+		exit(1);
+	}
 }
 /* 
  * Requires:
@@ -1030,7 +4696,7 @@ checklist() {
  */
 static void
 checkfreeblock(void *bp) {
-	if ((uintptr_t)bp % WSIZE) {
+	if ((uintptr_t)bp % ALIGN_SIZE) {
 		printf("Error: %p is not doubleword aligned\n", bp);
 		exit(1);
 	}
@@ -1045,6 +4711,309 @@ checkfreeblock(void *bp) {
 	}
 }
 
+/* 
+ * Requires:
+ *   "t" is a node of the tree of seglist "lst_indx", or NULL.  "lo" and
+ *   "hi" are the nodes that bound the subtree's keys, or NULL.
+ *
+ * Effects:
+ *   Helper routine that checks every block of a subtree is a free block of
+ *   the seglist's class and that the subtree is ordered by size and
+ *   address.  Returns the number of blocks in the subtree.
+ */
+static int
+checktree(struct free_tree_node *t, void *lo, void *hi, int lst_indx) {
+	if (t == NULL)
+		return (0);
+	if (!is_listed(t)) {
+		printf("Error: %p is missing from the listed bitmap\n",
+		    (void *)t);
+		exit(1);
+	}
+	checkfreeblock(t);
+	if (get_list_index(GET_SIZE(HDRP(t))) != lst_indx) {
+		printf("Error: block %p is in the tree of the wrong class\n",
+		    (void *)t);
+		exit(1);
+	}
+	if ((lo != NULL && !TREE_MORE(GET_SIZE(HDRP(t)), t, lo)) ||
+	    (hi != NULL && !TREE_LESS(GET_SIZE(HDRP(t)), t, hi))) {
+		printf("Error: tree of seglist %d is out of order\n",
+		    lst_indx);
+		exit(1);
+	}
+	return (1 + checktree(LEFT(t), lo, t, lst_indx) +
+	    checktree(RIGHT(t), t, hi, lst_indx));
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Return whether "bp" is the address of a block inside the heap whose
+ *   bit is set in the listed bitmap.
+ */
+static bool
+is_listed(void *bp) {
+	if ((char *)bp <= ms->heap_listp || (char *)bp >= heap_end() ||
+	    (uintptr_t)bp % ALIGN_SIZE != 0)
+		return (false);
+	return (GET_LISTED(bp));
+}
+
+/*
+ * Requires:
+ *   In thread-safe mode, the caller holds the heap lock.
+ *
+ * Effects:
+ *   Check the next "budget" blocks of the heap and heads of the seglists,
+ *   resuming where the last call stopped.  Each block is checked against
+ *   its neighbors in the heap and in its free list or tree, so every step
+ *   takes constant time and a full pass over the heap takes as many steps
+ *   as it has blocks.
+ */
+static void
+checkstep(size_t budget)
+{
+	char *bp, *end = heap_end();
+	size_t size;
+	int i;
+
+	while (budget-- > 0) {
+		if (ms->check_cursor == NULL) {
+			if (GET(HDRP(ms->heap_listp)) !=
+			    PACK(PROLOGUE_SIZE, PREV_ALLOC | ALLOC)) {
+				printf("Error: bad prologue header\n");
+				exit(1);
+			}
+			ms->check_cursor = NEXT_BLKP(ms->heap_listp);
+		}
+		bp = ms->check_cursor;
+		size = GET_SIZE(HDRP(bp));
+		/* Each step also checks the head of one seglist. */
+		i = ms->check_lst;
+		ms->check_lst = (ms->check_lst + 1) % seglst_lists;
+		if (((ms->seg_map[i / 64] >> (i % 64)) & 1) !=
+		    (ms->seg_lst[i] != NULL) ||
+		    (ms->seg_lst[i] != NULL && (!is_listed(ms->seg_lst[i]) ||
+		    (i < tree_lst && PREV_FREE(ms->seg_lst[i]) != NULL)))) {
+			printf("Error: bad head of seglist %d\n", i);
+			exit(1);
+		}
+		if (IS_SIDE_LIST(i))
+			checkside(i);
+		/* The epilogue ends the pass. */
+		if (size == 0) {
+			if (bp != end || !GET_ALLOC(HDRP(bp))) {
+				printf("Error: bad epilogue header at %p\n",
+				    (void *)bp);
+				exit(1);
+			}
+			ms->check_cursor = NULL;
+			continue;
+		}
+		if ((uintptr_t)bp % ALIGN_SIZE != 0 || size < 2 * DSIZE ||
+		    bp + size > end) {
+			printf("Error: %p has a bad header\n", (void *)bp);
+			exit(1);
+		}
+		/* the previous-allocated bit of the next block tracks this one */
+		if (!GET_PREV_ALLOC(HDRP(bp + size)) != !GET_ALLOC(HDRP(bp))) {
+			printf("Error: %p has a stale previous-allocated bit\n",
+			    (void *)(bp + size));
+			exit(1);
+		}
+		if (GET_ALLOC(HDRP(bp))) {
+			if (GET_LISTED(bp)) {
+				printf("Error: allocated block %p is in the "
+				    "free list\n", (void *)bp);
+				exit(1);
+			}
+		} else if ((bp == ms->top) != (bp + size == end) ||
+		    (bp == ms->top && GET_LISTED(bp))) {
+			printf("Error: %p is a bad top chunk\n", (void *)bp);
+			exit(1);
+		} else if (bp != ms->top)
+			checklinks(bp);
+		ms->check_cursor = bp + size;
+	}
+}
+
+/*
+ * Requires:
+ *   "bp" is the address of a free block.
+ *
+ * Effects:
+ *   Helper routine that checks the free block "bp" is coalesced and on
+ *   the free list or tree of its class, linked both ways with its
+ *   neighbors there.
+ */
+static void
+checklinks(void *bp)
+{
+	struct free_block_body *next, *prev;
+	struct free_tree_node *t = bp, *child;
+	int lst_indx = get_list_index(GET_SIZE(HDRP(bp)));
+
+	checkfreeblock(bp);
+	if (!GET_PREV_ALLOC(HDRP(bp)) || !GET_ALLOC(HDRP(NEXT_BLKP(bp)))) {
+		printf("Error: contiguous free block escaped coalescing\n");
+		exit(1);
+	}
+	if (!GET_LISTED(bp) ||
+	    !((ms->seg_map[lst_indx / 64] >> (lst_indx % 64)) & 1)) {
+		printf("Error: free block %p not in the free list\n", bp);
+		exit(1);
+	}
+	if (lst_indx >= tree_lst) {
+		/* each child is listed and on the right side of its parent */
+		child = LEFT(t);
+		if (child != NULL && (!is_listed(child) ||
+		    !TREE_LESS(GET_SIZE(HDRP(child)), child, t))) {
+			printf("Error: bad left child of %p\n", bp);
+			exit(1);
+		}
+		child = RIGHT(t);
+		if (child != NULL && (!is_listed(child) ||
+		    !TREE_MORE(GET_SIZE(HDRP(child)), child, t))) {
+			printf("Error: bad right child of %p\n", bp);
+			exit(1);
+		}
+		return;
+	}
+	next = NEXT_FREE(bp);
+	prev = PREV_FREE(bp);
+	if ((next != NULL && (!is_listed(next) || PREV_FREE(next) != bp)) ||
+	    (prev == NULL ? ms->seg_lst[lst_indx] != bp :
+	    !is_listed(prev) || NEXT_FREE(prev) != bp)) {
+		printf("Error: free list links of %p are broken\n", bp);
+		exit(1);
+	}
+}
+
+/*
+ * Requires:
+ *   List "lst_indx" has a side index.
+ *
+ * Effects:
+ *   Helper routine that checks the side index of the list holds the sizes
+ *   of exactly its first FIT_SEARCH_LIMIT blocks, in list order.
+ */
+static void
+checkside(int lst_indx)
+{
+	struct side_index *si = SIDE_OF(lst_indx);
+	struct free_block_body *bp = ms->seg_lst[lst_indx];
+	int i;
+
+	for (i = 0; i < FIT_SEARCH_LIMIT; i++) {
+		if (i < si->count ? bp == NULL || si->blk[i] != LINK(bp) ||
+		    si->size[i] != GET_SIZE(HDRP(bp)) :
+		    bp != NULL || si->size[i] != 0) {
+			printf("Error: side index of seglist %d is stale at "
+			    "%d\n", lst_indx, i);
+			exit(1);
+		}
+		if (bp != NULL)
+			bp = NEXT_FREE(bp);
+	}
+}
+
+/* 
+ * Requires:
+ *   "sp" is the address of a slab.
+ *
+ * Effects:
+ *   Helper routine that check slab consistency
+ */
+static void
+checkslab(struct slab *sp) {
+	struct slab *lp;
+	uint32_t nfree = 0;
+	int i;
+
+	if (sp->obj_size == 0) {
+		checknursery(sp);
+		return;
+	}
+	if (sp->obj_size > SLAB_MAX || sp->obj_size % ALIGN_SIZE != 0 ||
+	    GET_SIZE(HDRP(sp)) < SLAB_SIZE ||
+	    sp->objs + sp->nobjs * sp->obj_size >
+	    (char *)sp + GET_SIZE(HDRP(sp)) - WSIZE) {
+		printf("Error: slab %p has a bad header\n", (void *)sp);
+		exit(1);
+	}
+	for (i = 0; i < SLAB_MAP_WORDS; i++)
+		nfree += __builtin_popcountll(sp->free_map[i]);
+	for (i = sp->nobjs; i < SLAB_MAP_WORDS * 64; i++) {
+		if ((sp->free_map[i / 64] >> (i % 64)) & 1)
+			nfree = ~0U;
+	}
+	if (nfree != sp->nfree) {
+		printf("Error: slab %p free count does not match its bitmap\n",
+		    (void *)sp);
+		exit(1);
+	}
+	/* verify exactly the slabs with a free object are on the list */
+	for (lp = ms->slab_lst[sp->obj_size / ALIGN_SIZE - 1]; lp != NULL;
+	    lp = lp->next)
+		if (lp == sp)
+			break;
+	if ((lp != NULL) != (sp->nfree > 0)) {
+		printf("Error: slab %p is %son the list of its class\n",
+		    (void *)sp, lp != NULL ? "" : "not ");
+		exit(1);
+	}
+}
+
+/* 
+ * Requires:
+ *   "sp" is the address of a nursery chunk.
+ *
+ * Effects:
+ *   Helper routine that check nursery chunk consistency
+ */
+static void
+checknursery(struct slab *sp) {
+	struct slab *lp;
+	char *bp;
+	uint32_t live = 0;
+
+	if (GET_SIZE(HDRP(sp)) < SLAB_SIZE || sp->nfree > sp->nobjs ||
+	    (sp->used + WSIZE) % ALIGN_SIZE != 0 || sp->objs + sp->used >
+	    (char *)sp + GET_SIZE(HDRP(sp)) - WSIZE) {
+		printf("Error: nursery chunk %p has a bad header\n", (void *)sp);
+		exit(1);
+	}
+	for (bp = NURSERY_FIRST(sp); HDRP(bp) < sp->objs + sp->used;
+	    bp = NEXT_BLKP(bp)) {
+		if (GET_SIZE(HDRP(bp)) < 2 * DSIZE ||
+		    GET_SIZE(HDRP(bp)) > NURSERY_MAX ||
+		    GET_SIZE(HDRP(bp)) % ALIGN_SIZE != 0) {
+			printf("Error: nursery block %p has a bad size\n", bp);
+			exit(1);
+		}
+		if (GET_ALLOC(HDRP(bp)))
+			live++;
+	}
+	if (HDRP(bp) != sp->objs + sp->used ||
+	    live != sp->nobjs - sp->nfree) {
+		printf("Error: nursery chunk %p counts do not match its "
+		    "blocks\n", (void *)sp);
+		exit(1);
+	}
+	/* exactly the empty chunks but the current one are spares */
+	for (lp = ms->nursery_spare; lp != NULL && lp != sp; lp = lp->next)
+		;
+	if (lp != NULL ? live > 0 || sp == ms->nursery :
+	    live == 0 && sp != ms->nursery) {
+		printf("Error: nursery chunk %p is %sa spare\n", (void *)sp,
+		    lp != NULL ? "" : "not ");
+		exit(1);
+	}
+}
+
 /*
  * Requires:
  *   "bp" is the address of a block.
@@ -1065,13 +5034,20 @@ printblock(void *bp)
 
 	hsize = GET_SIZE(HDRP(bp)); 
 	halloc = GET_ALLOC(HDRP(bp));   
-	fsize = GET_SIZE(FTRP(bp)); 
-	falloc = GET_ALLOC(FTRP(bp));   
 
 	if (hsize == 0) {
 		printf("%p: end of heap\n", bp);
 		return;
 	}
+	if (halloc) {
+		/* allocated blocks have no footer */
+		printf("%p: header: [%zu:%c%c]\n", bp, hsize, 'a',
+		    (GET_PREV_ALLOC(HDRP(bp)) ? 'p' : '-'));
+		return;
+	}
+	fsize = GET_SIZE(FTRP(bp)); 
+	falloc = GET_ALLOC(FTRP(bp));   
+
 	/*
 	if (debug_flag) {
 		printf("printblock: reached_1\n");
@@ -1102,7 +5078,11 @@ printlist(int lstIndx) {
 		printf("printlist: lstIndx: %d\n", lstIndx); 
 	}
 	
-	bp = seg_lst[lstIndx]; 
+	bp = ms->seg_lst[lstIndx]; 
+	if (lstIndx >= tree_lst) {
+		printtree((struct free_tree_node *)bp);
+		return;
+	}
 	
 	while (bp != NULL) {
 		printblock(bp);
@@ -1112,11 +5092,27 @@ printlist(int lstIndx) {
 		//	checkblock(bp);
 		//}
 		
-		bp = bp->next;
+		bp = NEXT_FREE(bp);
 	}
 	
 }
 
+/*
+ * Requires:
+ *   "t" is a node of a tree of free blocks, or NULL.
+ *
+ * Effects:
+ *   Print the blocks of the subtree in order.
+ */
+static void
+printtree(struct free_tree_node *t) {
+	if (t == NULL)
+		return;
+	printtree(LEFT(t));
+	printblock(t);
+	printtree(RIGHT(t));
+}
+
 /*
  * The last lines of this file configure the behavior of the "Tab" key in
  * emacs.  Emacs has a rudimentary understanding of C syntax and style.  In
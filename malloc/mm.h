@@ -3,10 +3,88 @@
  * The public interface to the students' memory allocator.
  */
 
+struct mm_stats;
+struct mm_arena;
+struct mm_handle;
+
 int mm_init(void);
 void *mm_malloc(size_t size);
+void *mm_malloc_hint(size_t size, int hint);
+void *mm_malloc_near(void *ptr, size_t size);
 void mm_free(void *ptr);
 void *mm_realloc(void *ptr, size_t size);
+void *mm_memalign(size_t align, size_t size);
+void *mm_aligned_alloc(size_t align, size_t size);
+void *mm_calloc(size_t nmemb, size_t size);
+size_t mm_malloc_batch(size_t n, size_t size, void **out);
+void mm_free_batch(size_t n, void **ptrs);
+size_t mm_usable_size(void *ptr);
+size_t mm_trim(size_t pad);
+int mm_setopt(int option, size_t value);
+void mm_stats(struct mm_stats *stats);
+
+/* Movable blocks, reached through handles and compacted in place. */
+struct mm_handle *mm_halloc(size_t size);
+void mm_hfree(struct mm_handle *h);
+void *mm_hpin(struct mm_handle *h);
+void mm_hunpin(struct mm_handle *h);
+size_t mm_compact(size_t budget);
+
+/* Arenas: bump-pointer allocation, released all at once. */
+struct mm_arena *mm_arena_create(void);
+void *mm_arena_malloc(struct mm_arena *arena, size_t size);
+void mm_arena_reset(struct mm_arena *arena);
+void mm_arena_destroy(struct mm_arena *arena);
+
+/* Options for mm_setopt(). */
+#define MM_OPT_TRIM_THRESHOLD  1  /* Free bytes at the heap top to trim at */
+#define MM_OPT_MMAP_THRESHOLD  2  /* Smallest request given its own region */
+#define MM_OPT_CHECK_BUDGET    3  /* Blocks checked per 64 calls, 0 for none */
+#define MM_OPT_SEGLST_NUM      4  /* First-level size classes, at mm_init */
+#define MM_OPT_LOW_BOUND       5  /* Smallest first-level class, at mm_init */
+#define MM_OPT_CHUNKSIZE       6  /* Least the heap grows by, at mm_init */
+#define MM_OPT_POLICY          7  /* Placement policy, at mm_init */
+#define MM_OPT_LIFETIME        8  /* Place by predicted lifetime, 1 or 0 */
+
+/* Placement policies for MM_OPT_POLICY. */
+#define MM_POLICY_LIFO     0  /* Newest block first, first fit; the default */
+#define MM_POLICY_NEXT     1  /* First fit from where the last search ended */
+#define MM_POLICY_BEST     2  /* Smallest block that fits */
+#define MM_POLICY_ADDRESS  3  /* Lowest address first, first fit */
+#define MM_POLICIES        4
+
+/* Lifetime hints for mm_malloc_hint(). */
+#define MM_HINT_NONE   0  /* Predict the lifetime from the size */
+#define MM_HINT_SHORT  1  /* Freed soon: kept apart from long-lived blocks */
+#define MM_HINT_LONG   2  /* Kept until much later */
+
+/*
+ * A snapshot of the allocator filled in by mm_stats().  Size class i holds
+ * free blocks of at least class_size[i] bytes.  The event counters stay
+ * zero unless mm.c is built with MM_STATS.
+ */
+#define MM_STATS_CLASSES  224 /* Room for every size class */
+#define MM_STATS_SEARCH   8   /* Search lengths 0, 1, 2-3, ..., 64 and up */
+
+struct mm_stats {
+    size_t heap_size;    /* Bytes of heap obtained from memlib */
+    size_t mapped_size;  /* Bytes mapped for huge blocks and handles */
+    size_t live_bytes;   /* Payload bytes of allocated heap blocks */
+    size_t free_bytes;   /* Bytes of blocks on the free lists */
+    size_t fast_bytes;   /* Bytes of freed blocks held in fast bins */
+    size_t top_bytes;    /* Bytes of the free block that ends the heap */
+    int nclasses;        /* Number of size classes */
+    size_t class_size[MM_STATS_CLASSES];
+    size_t class_count[MM_STATS_CLASSES]; /* Free blocks per class */
+    size_t class_bytes[MM_STATS_CLASSES]; /* Free bytes per class */
+    /* Event counters */
+    unsigned long splits;          /* Free blocks split by an allocation */
+    unsigned long coalesces;       /* Freed blocks merged with a neighbor */
+    unsigned long extends;         /* Times the heap was grown */
+    unsigned long realloc_inplace; /* Reallocs that kept their address */
+    unsigned long realloc_copy;    /* Reallocs that moved the payload */
+    unsigned long search_hist[MM_STATS_SEARCH]; /* Free list search lengths */
+};
 
 /* 
  * Students work in teams of one or two.  Teams enter their team name, personal
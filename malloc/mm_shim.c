@@ -0,0 +1,206 @@
+/*
+ * mm_shim.c - replace the C library's malloc with mm.c.
+ *
+ * Built into libmm.so together with mm.c and memlib.c, this file defines
+ * the C library's allocation functions in terms of the mm_ interface, so
+ * any dynamically linked program can run on the allocator:
+ *
+ *	LD_PRELOAD=./libmm.so program ...
+ *
+ * The heap is set up on the first call.  A pointer that did not come from
+ * memlib's storage, such as one allocated by the dynamic linker before
+ * the library was loaded, is never handed to mm.c: freeing it does
+ * nothing.  The caller is expected not to fork while another thread is
+ * inside the allocator, as the child would inherit the held locks.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "memlib.h"
+#include "mm.h"
+
+void *memalign(size_t align, size_t size);
+void *valloc(size_t size);
+void *pvalloc(size_t size);
+size_t malloc_usable_size(void *ptr);
+
+static pthread_once_t shim_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Create the memory system and the empty heap, or abort if the heap
+ *   cannot be created, as nothing could be allocated at all.
+ */
+static void
+shim_init(void)
+{
+
+	mem_init();
+	if (mm_init() < 0)
+		abort();
+}
+
+/*
+ * Requires:
+ *   None.
+ *
+ * Effects:
+ *   Return whether "ptr" lies within memlib's storage, and so is a block
+ *   of the allocator.  The storage is only reserved once the heap exists.
+ */
+static bool
+is_ours(void *ptr)
+{
+	char *lo = mem_heap_lo();
+
+	return (lo != NULL && (char *)ptr >= lo && (char *)ptr < lo + MAX_HEAP);
+}
+
+/*
+ * Requires:
+ *   "align" is a power of two.
+ *
+ * Effects:
+ *   Allocate "size" bytes aligned to "align", setting errno to ENOMEM and
+ *   returning NULL on failure.  An allocation of zero bytes returns a
+ *   unique pointer, as the C library's does.
+ */
+static void *
+shim_alloc(size_t align, size_t size)
+{
+	void *ptr;
+
+	pthread_once(&shim_once, shim_init);
+	if (size == 0)
+		size = 1;
+	if ((ptr = mm_memalign(align, size)) == NULL)
+		errno = ENOMEM;
+	return (ptr);
+}
+
+void *
+malloc(size_t size)
+{
+	void *ptr;
+
+	pthread_once(&shim_once, shim_init);
+	if ((ptr = mm_malloc(size == 0 ? 1 : size)) == NULL)
+		errno = ENOMEM;
+	return (ptr);
+}
+
+void
+free(void *ptr)
+{
+
+	if (ptr != NULL && is_ours(ptr))
+		mm_free(ptr);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	void *ptr;
+
+	pthread_once(&shim_once, shim_init);
+	if (nmemb == 0 || size == 0)
+		nmemb = size = 1;
+	if ((ptr = mm_calloc(nmemb, size)) == NULL)
+		errno = ENOMEM;
+	return (ptr);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	void *newptr;
+
+	if (ptr == NULL)
+		return (malloc(size));
+	/* A foreign block's size is unknown, so it cannot be moved. */
+	if (!is_ours(ptr)) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+	if ((newptr = mm_realloc(ptr, size)) == NULL && size != 0)
+		errno = ENOMEM;
+	return (newptr);
+}
+
+int
+posix_memalign(void **memptr, size_t align, size_t size)
+{
+	void *ptr;
+
+	if (align % sizeof(void *) != 0 || (align & (align - 1)) != 0 ||
+	    align == 0)
+		return (EINVAL);
+	if ((ptr = shim_alloc(align, size)) == NULL)
+		return (ENOMEM);
+	*memptr = ptr;
+	return (0);
+}
+
+void *
+aligned_alloc(size_t align, size_t size)
+{
+	void *ptr;
+
+	if (align == 0 || (align & (align - 1)) != 0) {
+		errno = EINVAL;
+		return (NULL);
+	}
+	pthread_once(&shim_once, shim_init);
+	if ((ptr = mm_aligned_alloc(align, size == 0 ? 1 : size)) == NULL)
+		errno = ENOMEM;
+	return (ptr);
+}
+
+void *
+memalign(size_t align, size_t size)
+{
+
+	if (align == 0 || (align & (align - 1)) != 0) {
+		errno = EINVAL;
+		return (NULL);
+	}
+	return (shim_alloc(align, size));
+}
+
+void *
+valloc(size_t size)
+{
+
+	return (shim_alloc(mem_pagesize(), size));
+}
+
+void *
+pvalloc(size_t size)
+{
+	size_t pagesize = mem_pagesize();
+
+	if (size > SIZE_MAX - pagesize) {
+		errno = ENOMEM;
+		return (NULL);
+	}
+	return (shim_alloc(pagesize, (size + pagesize - 1) & ~(pagesize - 1)));
+}
+
+size_t
+malloc_usable_size(void *ptr)
+{
+
+	if (ptr == NULL || !is_ours(ptr))
+		return (0);
+	return (mm_usable_size(ptr));
+}